@@ -0,0 +1,328 @@
+/* ReaPack: Package manager for REAPER
+ * Copyright (C) 2015-2017  Christian Fillion
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "api.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include <reaper_plugin_functions.h>
+
+#ifdef _WIN32
+#  include <direct.h>
+#  define mkdir(path, mode) _mkdir(path)
+#else
+#  include <condition_variable>
+#  include <fstream>
+#  include <mutex>
+#  include <swell-types.h>
+#  include <sys/stat.h>
+#endif
+
+using namespace std;
+
+static string g_resourcePath;
+static void (*g_timer)() = nullptr;
+
+static int PluginRegister(const char *name, void *info)
+{
+  if(!strcmp(name, "timer"))
+    g_timer = (void (*)())info;
+  else if(!strcmp(name, "-timer"))
+    g_timer = nullptr;
+
+  return 1;
+}
+
+static const char *AppVersion() { return "0.0/reapack-cli"; }
+static const char *ResourcePath() { return g_resourcePath.c_str(); }
+static int PlayState() { return 0; } // stopped, downloads are never slowed down
+
+static int MakeDirectory(const char *path, size_t)
+{
+  string partial;
+
+  for(const char *c = path; *c; c++) {
+    if((*c == '/' || *c == '\\') && !partial.empty())
+      mkdir(partial.c_str(), 0777);
+
+    partial += *c;
+  }
+
+  mkdir(partial.c_str(), 0777);
+  return 1;
+}
+
+static bool FileExists(const char *path)
+{
+  FILE *file = fopen(path, "rb");
+  if(file)
+    fclose(file);
+  return file != nullptr;
+}
+
+#if !defined(_WIN32) && !defined(__APPLE__)
+// On Linux the functions of SWELL are provided by REAPER. This is a minimal
+// implementation of those used by the core: reading and writing reapack.ini,
+// and the events and threads of the worker pool.
+
+extern "C" int SWELL_dllMain(HINSTANCE, DWORD, LPVOID);
+
+typedef vector<pair<string, string>> IniSection;
+typedef vector<pair<string, IniSection>> IniFile;
+
+static IniFile ReadIni(const char *fn)
+{
+  IniFile ini;
+  ifstream stream(fn);
+  string line;
+
+  while(getline(stream, line)) {
+    if(!line.empty() && line.back() == '\r')
+      line.pop_back();
+
+    if(line.size() > 1 && line.front() == '[' && line.back() == ']')
+      ini.push_back({line.substr(1, line.size() - 2), {}});
+    else if(!ini.empty()) {
+      const size_t equal = line.find('=');
+      if(equal != string::npos)
+        ini.back().second.push_back({line.substr(0, equal), line.substr(equal + 1)});
+    }
+  }
+
+  return ini;
+}
+
+static void WriteIni(const char *fn, const IniFile &ini)
+{
+  ofstream stream(fn);
+
+  for(const auto &section : ini) {
+    stream << '[' << section.first << "]\n";
+
+    for(const auto &pair : section.second)
+      stream << pair.first << '=' << pair.second << '\n';
+  }
+}
+
+static DWORD GetIniString(const char *appname, const char *keyname,
+  const char *def, char *ret, int retsize, const char *fn)
+{
+  string value = def ? def : "";
+
+  for(const auto &section : ReadIni(fn)) {
+    if(section.first != appname)
+      continue;
+
+    for(const auto &pair : section.second) {
+      if(pair.first == keyname)
+        value = pair.second;
+    }
+  }
+
+  if(retsize < 1)
+    return 0;
+
+  const size_t size = min(value.size(), (size_t)retsize - 1);
+  memcpy(ret, value.c_str(), size);
+  ret[size] = 0;
+
+  return (DWORD)size;
+}
+
+static int GetIniInt(const char *appname, const char *keyname,
+  int def, const char *fn)
+{
+  char buf[32];
+  if(!GetIniString(appname, keyname, "", buf, sizeof(buf), fn) || !*buf)
+    return def;
+
+  return atoi(buf);
+}
+
+static BOOL WriteIniString(const char *appname, const char *keyname,
+  const char *val, const char *fn)
+{
+  IniFile ini = ReadIni(fn);
+
+  auto section = find_if(ini.begin(), ini.end(),
+    [=] (const pair<string, IniSection> &s) { return s.first == appname; });
+
+  if(!keyname) { // removes the whole section
+    if(section != ini.end())
+      ini.erase(section);
+  }
+  else {
+    if(section == ini.end())
+      section = ini.insert(ini.end(), {appname, {}});
+
+    IniSection &pairs = section->second;
+    auto it = find_if(pairs.begin(), pairs.end(),
+      [=] (const pair<string, string> &p) { return p.first == keyname; });
+
+    if(!val) { // removes the key
+      if(it != pairs.end())
+        pairs.erase(it);
+    }
+    else if(it != pairs.end())
+      it->second = val;
+    else
+      pairs.push_back({keyname, val});
+  }
+
+  WriteIni(fn, ini);
+  return true;
+}
+
+// an event, or a thread signaled once it returns
+struct WaitObject {
+  mutex guard;
+  condition_variable cond;
+  bool signaled;
+  bool manualReset;
+  thread worker;
+};
+
+static BOOL SignalObject(HANDLE handle)
+{
+  WaitObject *obj = static_cast<WaitObject *>(handle);
+
+  lock_guard<mutex> lock(obj->guard);
+  obj->signaled = true;
+  obj->cond.notify_all();
+
+  return true;
+}
+
+static BOOL UnsignalObject(HANDLE handle)
+{
+  WaitObject *obj = static_cast<WaitObject *>(handle);
+
+  lock_guard<mutex> lock(obj->guard);
+  obj->signaled = false;
+
+  return true;
+}
+
+static HANDLE NewEvent(void *, const BOOL manualReset,
+  const BOOL initialState, const char *)
+{
+  WaitObject *obj = new WaitObject;
+  obj->signaled = initialState != 0;
+  obj->manualReset = manualReset != 0;
+
+  return obj;
+}
+
+static HANDLE NewThread(void *, DWORD, DWORD (*proc)(LPVOID),
+  LPVOID param, DWORD, DWORD *)
+{
+  WaitObject *obj = new WaitObject;
+  obj->signaled = false;
+  obj->manualReset = true;
+  obj->worker = thread([=] { proc(param); SignalObject(obj); });
+
+  return obj;
+}
+
+static DWORD WaitForObject(HANDLE handle, const DWORD timeout)
+{
+  WaitObject *obj = static_cast<WaitObject *>(handle);
+  const auto isSignaled = [obj] { return obj->signaled; };
+
+  unique_lock<mutex> lock(obj->guard);
+
+  if(timeout == INFINITE)
+    obj->cond.wait(lock, isSignaled);
+  else if(!obj->cond.wait_for(lock, chrono::milliseconds(timeout), isSignaled))
+    return WAIT_TIMEOUT;
+
+  if(!obj->manualReset)
+    obj->signaled = false;
+
+  return WAIT_OBJECT_0;
+}
+
+static BOOL CloseObject(HANDLE handle)
+{
+  WaitObject *obj = static_cast<WaitObject *>(handle);
+
+  // the worker threads are always waited for before being closed
+  if(obj->worker.joinable())
+    obj->worker.join();
+
+  delete obj;
+  return true;
+}
+
+static void *GetSwellFunc(const char *name)
+{
+  if(!strcmp(name, "GetPrivateProfileString"))
+    return (void *)GetIniString;
+  else if(!strcmp(name, "GetPrivateProfileInt"))
+    return (void *)GetIniInt;
+  else if(!strcmp(name, "WritePrivateProfileString"))
+    return (void *)WriteIniString;
+  else if(!strcmp(name, "CreateEvent"))
+    return (void *)NewEvent;
+  else if(!strcmp(name, "CreateThread"))
+    return (void *)NewThread;
+  else if(!strcmp(name, "SetEvent"))
+    return (void *)SignalObject;
+  else if(!strcmp(name, "ResetEvent"))
+    return (void *)UnsignalObject;
+  else if(!strcmp(name, "WaitForSingleObject"))
+    return (void *)WaitForObject;
+  else if(!strcmp(name, "CloseHandle"))
+    return (void *)CloseObject;
+
+  return nullptr;
+}
+#endif
+
+void UseCliApi(const string &resourcePath)
+{
+  g_resourcePath = resourcePath;
+
+  plugin_register = PluginRegister;
+  GetAppVersion = AppVersion;
+  GetResourcePath = ResourcePath;
+  RecursiveCreateDirectory = MakeDirectory;
+  file_exists = FileExists;
+  GetPlayState = PlayState;
+
+  // scripts are not registered in the action list of REAPER
+  AddRemoveReaScript = nullptr;
+
+#if !defined(_WIN32) && !defined(__APPLE__)
+  SWELL_dllMain(nullptr, DLL_PROCESS_ATTACH, (void *)GetSwellFunc);
+#endif
+}
+
+void RunTimers(const function<bool ()> &done)
+{
+  while(!done()) {
+    if(g_timer)
+      g_timer();
+
+    this_thread::sleep_for(chrono::milliseconds(10));
+  }
+}
@@ -0,0 +1,32 @@
+/* ReaPack: Package manager for REAPER
+ * Copyright (C) 2015-2017  Christian Fillion
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef REAPACK_CLI_API_HPP
+#define REAPACK_CLI_API_HPP
+
+#include <functional>
+#include <string>
+
+// Implements the few REAPER API functions used by the core, so that it can
+// run outside of REAPER.
+void UseCliApi(const std::string &resourcePath);
+
+// Runs the main thread timer registered by the worker threads until
+// done() returns true.
+void RunTimers(const std::function<bool ()> &done);
+
+#endif
@@ -0,0 +1,323 @@
+/* ReaPack: Package manager for REAPER
+ * Copyright (C) 2015-2017  Christian Fillion
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "api.hpp"
+
+#include <archive.hpp>
+#include <config.hpp>
+#include <download.hpp>
+#include <errors.hpp>
+#include <filesystem.hpp>
+#include <index.hpp>
+#include <ratelimit.hpp>
+#include <remote.hpp>
+#include <transaction.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+using namespace std;
+
+static const char *USAGE =
+  "Usage: reapack-cli [options] <command> [arguments]\n"
+  "\n"
+  "Commands:\n"
+  "  sync [repository...]    synchronize the enabled or the given repositories\n"
+  "  install <repository> <category> <package> [version]\n"
+  "                          install a package, by default its latest version\n"
+  "  export <file>           export the installed packages to an offline archive\n"
+  "\n"
+  "Options:\n"
+  "  -r <path>   REAPER resource directory (default: current directory)\n"
+  "  -p          uninstall the packages removed from their repository\n"
+  "\n"
+  "Exit status: 0 on success, 1 if anything failed, 2 on invalid usage\n";
+
+enum ExitStatus {
+  ExitSuccess = 0,
+  ExitFailure = 1,
+  ExitUsage   = 2,
+};
+
+typedef chrono::steady_clock Clock;
+
+static double Seconds(const Clock::time_point &since)
+{
+  return chrono::duration<double>(Clock::now() - since).count();
+}
+
+static void PrintError(const ErrorInfo &error)
+{
+  fprintf(stderr, "error: %s: %s\n", error.context.c_str(), error.message.c_str());
+}
+
+class Cli {
+public:
+  Cli(const string &resourcePath, bool removeObsolete);
+  ~Cli();
+
+  int sync(const vector<string> &remotes);
+  int install(const vector<string> &args);
+  int exportArchive(const string &path);
+
+private:
+  Transaction *createTransaction();
+  int runTransaction(Transaction *, const Clock::time_point &start);
+  bool fetchIndex(const Remote &);
+
+  UseRootPath m_root;
+  bool m_removeObsolete;
+  Config m_config;
+  unique_ptr<ThreadPool> m_threadPool;
+};
+
+Cli::Cli(const string &resourcePath, const bool removeObsolete)
+  : m_root(resourcePath), m_removeObsolete(removeObsolete)
+{
+  DownloadContext::GlobalInit();
+
+  FS::mkdir(Path::CACHE);
+  m_config.read(Path::prefixRoot(Path::CONFIG));
+
+  const NetworkOpts &opts = m_config.network;
+
+  m_threadPool = make_unique<ThreadPool>(m_config.install.workerThreads);
+  m_threadPool->setScheduling(opts.lowPriority, opts.reservedCpus);
+  RateLimiter::get()->setRates(
+    int64_t(opts.maxRate) * 1024, int64_t(opts.playbackRate) * 1024);
+}
+
+Cli::~Cli()
+{
+  // wait for the workers before cleaning up the transfers
+  m_threadPool.reset();
+
+  DownloadContext::GlobalCleanup();
+}
+
+int Cli::sync(const vector<string> &names)
+{
+  vector<Remote> remotes;
+
+  if(names.empty())
+    remotes = m_config.remotes.getEnabled();
+
+  for(const string &name : names) {
+    const Remote &remote = m_config.remotes.get(name);
+
+    if(!remote) {
+      fprintf(stderr, "reapack-cli: unknown repository '%s'\n", name.c_str());
+      return ExitFailure;
+    }
+
+    remotes.push_back(remote);
+  }
+
+  const Clock::time_point start = Clock::now();
+  Transaction *tx = createTransaction();
+
+  for(const Remote &remote : remotes)
+    tx->synchronize(remote);
+
+  return runTransaction(tx, start);
+}
+
+int Cli::install(const vector<string> &args)
+{
+  const Clock::time_point start = Clock::now();
+  const Remote &remote = m_config.remotes.get(args[0]);
+
+  if(!remote) {
+    fprintf(stderr, "reapack-cli: unknown repository '%s'\n", args[0].c_str());
+    return ExitFailure;
+  }
+  else if(!fetchIndex(remote))
+    return ExitFailure;
+
+  const IndexPtr &ri = Index::load(remote.name());
+  const Package *pkg = ri->find(args[1], args[2]);
+
+  if(!pkg) {
+    fprintf(stderr, "reapack-cli: %s/%s cannot be found in %s\n",
+      args[1].c_str(), args[2].c_str(), remote.name().c_str());
+    return ExitFailure;
+  }
+
+  const Version *ver = args.size() > 3 ? pkg->findVersion(args[3]) :
+    pkg->lastVersion(m_config.install.bleedingEdge);
+
+  if(!ver) {
+    fprintf(stderr, "reapack-cli: no suitable version of %s\n",
+      pkg->fullName().c_str());
+    return ExitFailure;
+  }
+
+  Transaction *tx = createTransaction();
+  tx->install(ver);
+
+  return runTransaction(tx, start);
+}
+
+int Cli::exportArchive(const string &path)
+{
+  const Clock::time_point start = Clock::now();
+  TaskGroup tasks(m_threadPool.get());
+  size_t errors = 0;
+
+  tasks.onPush([&] (ThreadTask *task) {
+    task->onFinish([&, task] {
+      if(task->state() != ThreadTask::Failure)
+        return;
+
+      PrintError(task->error());
+      errors++;
+    });
+  });
+
+  const size_t count = Archive::create(make_autostring(path), &tasks, &m_config);
+  RunTimers([&] { return tasks.idle(); });
+
+  printf("%zu package(s) exported to %s in %.2fs\n",
+    count, path.c_str(), Seconds(start));
+
+  return errors ? ExitFailure : ExitSuccess;
+}
+
+Transaction *Cli::createTransaction()
+{
+  Transaction *tx = new Transaction(&m_config, m_threadPool.get());
+
+  tx->setObsoleteHandler([=] (vector<Registry::Entry> &entries) {
+    for(const Registry::Entry &entry : entries) {
+      printf("%s: %s/%s/%s\n", m_removeObsolete ? "uninstalling" : "obsolete",
+        entry.remote.c_str(), entry.category.c_str(), entry.package.c_str());
+    }
+
+    return m_removeObsolete;
+  });
+
+  // continue where the last transaction was interrupted
+  tx->resume();
+
+  return tx;
+}
+
+int Cli::runTransaction(Transaction *tx, const Clock::time_point &start)
+{
+  bool done = false;
+  TaskGroup::Metrics metrics{};
+
+  tx->onFinish([&] { metrics = tx->tasks()->metrics(); });
+  tx->setCleanupHandler([&] { done = true; });
+
+  tx->runTasks();
+  RunTimers([&] { return done; });
+
+  const Receipt *receipt = tx->receipt();
+
+  for(const ErrorInfo &error : receipt->errors())
+    PrintError(error);
+
+  printf("%zu installed, %zu updated, %zu removed, %zu error(s)\n",
+    receipt->installs().size(), receipt->updates().size(),
+    receipt->removals().size(), receipt->errors().size());
+
+  printf("%.2fs, %.1f KiB downloaded at %.1f KiB/s\n", Seconds(start),
+    metrics.bytesReceived / 1024.0, metrics.throughput / 1024.0);
+
+  if(receipt->isRestartNeeded())
+    printf("REAPER must be restarted for the changes to take effect\n");
+
+  const bool failed = tx->isCancelled() || receipt->hasErrors();
+  delete tx;
+
+  return failed ? ExitFailure : ExitSuccess;
+}
+
+bool Cli::fetchIndex(const Remote &remote)
+{
+  FileDownload *dl = Index::fetch(remote, false, m_config.network);
+
+  if(!dl)
+    return true; // downloaded less than a week ago
+
+  bool done = false, success = false;
+
+  dl->onFinish([&] {
+    success = dl->save() && dl->state() == ThreadTask::Success;
+
+    if(!success)
+      PrintError(dl->error());
+
+    done = true;
+  });
+
+  dl->setCleanupHandler([=] { delete dl; });
+
+  m_threadPool->push(dl);
+  RunTimers([&] { return done; });
+
+  return success;
+}
+
+int main(int argc, char *argv[])
+{
+  string resourcePath = ".";
+  bool removeObsolete = false;
+
+  int i = 1;
+
+  for(; i < argc && argv[i][0] == '-'; i++) {
+    if(!strcmp(argv[i], "-r") && i + 1 < argc)
+      resourcePath = argv[++i];
+    else if(!strcmp(argv[i], "-p"))
+      removeObsolete = true;
+    else {
+      fputs(USAGE, stderr);
+      return ExitUsage;
+    }
+  }
+
+  if(i >= argc) {
+    fputs(USAGE, stderr);
+    return ExitUsage;
+  }
+
+  const string command = argv[i++];
+  const vector<string> args(argv + i, argv + argc);
+
+  UseCliApi(resourcePath);
+
+  try {
+    Cli cli(resourcePath, removeObsolete);
+
+    if(command == "sync")
+      return cli.sync(args);
+    else if(command == "install" && (args.size() == 3 || args.size() == 4))
+      return cli.install(args);
+    else if(command == "export" && args.size() == 1)
+      return cli.exportArchive(args[0]);
+  }
+  catch(const reapack_error &e) {
+    fprintf(stderr, "reapack-cli: %s\n", e.what());
+    return ExitFailure;
+  }
+
+  fputs(USAGE, stderr);
+  return ExitUsage;
+}
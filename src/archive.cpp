@@ -22,7 +22,6 @@
 #include "filesystem.hpp"
 #include "index.hpp"
 #include "path.hpp"
-#include "reapack.hpp"
 #include "transaction.hpp"
 
 #include <boost/format.hpp>
@@ -71,16 +70,17 @@ struct ImportArchive {
   IndexPtr m_lastIndex;
 };
 
-void Archive::import(const auto_string &path, ReaPack *reapack)
+void Archive::import(const auto_string &path, Config *config,
+  const TransactionFactory &setupTransaction)
 {
-  ImportArchive state{make_shared<ArchiveReader>(path), &reapack->config()->remotes};
+  ImportArchive state{make_shared<ArchiveReader>(path), &config->remotes};
 
   stringstream toc;
   if(const int err = state.m_reader->extractFile(ARCHIVE_TOC, toc))
     throw reapack_error(format("Cannot locate the table of contents (%d)") % err);
 
   // starting import, do not abort process (eg. by throwing) at this point
-  if(!(state.m_tx = reapack->setupTransaction()))
+  if(!(state.m_tx = setupTransaction()))
     return;
 
   string line;
@@ -108,7 +108,7 @@ void Archive::import(const auto_string &path, ReaPack *reapack)
     }
   }
 
-  reapack->config()->write();
+  config->write();
   state.m_tx->runTasks();
 }
 
@@ -160,6 +160,23 @@ void ImportArchive::importPackage(const string &data)
 }
 
 ArchiveReader::ArchiveReader(const auto_string &path)
+  : m_path(path)
+{
+  zipFile zip = open();
+
+  if(!zip)
+    throw reapack_error(FS::lastError().c_str());
+
+  m_idle.push_back(zip);
+}
+
+ArchiveReader::~ArchiveReader()
+{
+  for(zipFile zip : m_idle)
+    unzClose(zip);
+}
+
+zipFile ArchiveReader::open() const
 {
   zlib_filefunc64_def filefunc;
   fill_fopen64_filefunc(&filefunc);
@@ -167,15 +184,29 @@ ArchiveReader::ArchiveReader(const auto_string &path)
   filefunc.zopen64_file = wide_fopen;
 #endif
 
-  m_zip = unzOpen2_64(reinterpret_cast<const char *>(path.c_str()), &filefunc);
+  return unzOpen2_64(reinterpret_cast<const char *>(m_path.c_str()), &filefunc);
+}
 
-  if(!m_zip)
-    throw reapack_error(FS::lastError().c_str());
+zipFile ArchiveReader::acquire()
+{
+  {
+    WDL_MutexLock lock(&m_mutex);
+
+    if(!m_idle.empty()) {
+      zipFile zip = m_idle.back();
+      m_idle.pop_back();
+      return zip;
+    }
+  }
+
+  // unzip handles hold the position of the current file, they cannot be shared
+  return open();
 }
 
-ArchiveReader::~ArchiveReader()
+void ArchiveReader::release(zipFile zip)
 {
-  unzClose(m_zip);
+  WDL_MutexLock lock(&m_mutex);
+  m_idle.push_back(zip);
 }
 
 int ArchiveReader::extractFile(const Path &path)
@@ -188,30 +219,47 @@ int ArchiveReader::extractFile(const Path &path)
     throw reapack_error(format("%s: %s") % path.join() % FS::lastError());
 }
 
-int ArchiveReader::extractFile(const Path &path, ostream &stream) noexcept
+int ArchiveReader::extractFile(const Path &path, ostream &stream,
+  const Archive::CancelCallback &cancel) noexcept
 {
-  int status = unzLocateFile(m_zip, path.join('/').c_str(), false);
-  if(status != UNZ_OK)
-    return status;
+  zipFile zip = acquire();
+  if(!zip)
+    return UNZ_ERRNO;
 
-  status = unzOpenCurrentFile(m_zip);
-  if(status != UNZ_OK)
+  int status = unzLocateFile(zip, path.join('/').c_str(), false);
+
+  if(status == UNZ_OK)
+    status = unzOpenCurrentFile(zip);
+
+  if(status != UNZ_OK) {
+    release(zip);
     return status;
+  }
 
   string buffer(BUFFER_SIZE, 0);
 
   const auto readChunk = [&] {
-    return unzReadCurrentFile(m_zip, &buffer[0], (int)buffer.size());
+    return unzReadCurrentFile(zip, &buffer[0], (int)buffer.size());
   };
 
   while(const int len = readChunk()) {
-    if(len < 0)
-      return len; // read error
+    if(len < 0) {
+      status = len; // read error
+      break;
+    }
 
     stream.write(&buffer[0], len);
+
+    if(cancel && cancel()) {
+      status = Archive::Cancelled;
+      break;
+    }
   }
 
-  return unzCloseCurrentFile(m_zip);
+  const int closeStatus = unzCloseCurrentFile(zip);
+  release(zip);
+
+  return status != UNZ_OK ? status : closeStatus;
 }
 
 FileExtractor::FileExtractor(const Path &target, const ArchiveReaderPtr &reader)
@@ -235,10 +283,13 @@ void FileExtractor::run(DownloadContext *)
     return;
   }
 
-  const int error = m_reader->extractFile(m_path.target(), stream);
+  const int error = m_reader->extractFile(m_path.target(), stream,
+    [this] { return aborted(); });
   stream.close();
 
-  if(error) {
+  if(error == Archive::Cancelled)
+    finish(Aborted, {"cancelled", m_path.target().join()});
+  else if(error) {
     const format &msg = format("Failed to extract file (%d)") % error;
     finish(Failure, {msg.str(), m_path.target().join()});
   }
@@ -246,7 +297,8 @@ void FileExtractor::run(DownloadContext *)
     finish(Success);
 }
 
-size_t Archive::create(const auto_string &path, ThreadPool *pool, ReaPack *reapack)
+size_t Archive::create(const auto_string &path,
+  TaskGroup *tasks, const Config *config)
 {
   size_t count = 0;
   vector<ThreadTask *> jobs;
@@ -256,7 +308,7 @@ size_t Archive::create(const auto_string &path, ThreadPool *pool, ReaPack *reapa
 
   ArchiveWriterPtr writer = make_shared<ArchiveWriter>(path);
 
-  for(const Remote &remote : reapack->config()->remotes.getEnabled()) {
+  for(const Remote &remote : config->remotes.getEnabled()) {
     bool addedRemote = false;
 
     for(const Registry::Entry &entry : reg.getEntries(remote.name())) {
@@ -284,7 +336,7 @@ size_t Archive::create(const auto_string &path, ThreadPool *pool, ReaPack *reapa
 
   // start after we've written the table of contents in the main thread
   for(ThreadTask *job : jobs)
-    pool->push(job);
+    tasks->push(job);
 
   return count;
 }
@@ -319,7 +371,8 @@ int ArchiveWriter::addFile(const Path &path)
     throw reapack_error(format("%s: %s") % path.join() % FS::lastError());
 }
 
-int ArchiveWriter::addFile(const Path &path, istream &stream) noexcept
+int ArchiveWriter::addFile(const Path &path, istream &stream,
+  const Archive::CancelCallback &cancel) noexcept
 {
   const int status = zipOpenNewFileInZip(m_zip, path.join('/').c_str(), nullptr,
     nullptr, 0, nullptr, 0, nullptr, Z_DEFLATED, Z_DEFAULT_COMPRESSION);
@@ -339,6 +392,11 @@ int ArchiveWriter::addFile(const Path &path, istream &stream) noexcept
       return len; // write error
 
     zipWriteInFileInZip(m_zip, &buffer[0], len);
+
+    if(cancel && cancel()) {
+      zipCloseFileInZip(m_zip);
+      return Archive::Cancelled;
+    }
   }
 
   return zipCloseFileInZip(m_zip);
@@ -365,10 +423,13 @@ void FileCompressor::run(DownloadContext *)
     return;
   }
 
-  const int error = m_writer->addFile(m_path, stream);
+  const int error = m_writer->addFile(m_path, stream,
+    [this] { return aborted(); });
   stream.close();
 
-  if(error) {
+  if(error == Archive::Cancelled)
+    finish(Aborted, {"cancelled", m_path.join()});
+  else if(error) {
     const format &msg = format("Failed to compress file (%d)") % error;
     finish(Failure, {msg.str(), m_path.join()});
   }
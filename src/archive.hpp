@@ -22,25 +22,45 @@
 #include "path.hpp"
 #include "thread.hpp"
 
-class ReaPack;
-class ThreadPool;
+#include <functional>
+#include <vector>
+
+#include <WDL/mutex.h>
+
+class Config;
+class TaskGroup;
+class Transaction;
 
 typedef void *zipFile;
 
 namespace Archive {
-  void import(const auto_string &path, ReaPack *);
-  size_t create(const auto_string &path, ThreadPool *pool, ReaPack *);
+  typedef std::function<bool ()> CancelCallback;
+  typedef std::function<Transaction *()> TransactionFactory;
+  // returned when cancelled midway, the zlib error codes are negative
+  const int Cancelled = 1;
+
+  void import(const auto_string &path, Config *, const TransactionFactory &);
+  size_t create(const auto_string &path, TaskGroup *, const Config *);
 };
 
+// Safe to use from several threads at once: each extraction gets its own
+// read-only handle to the archive, reused by the following ones.
 class ArchiveReader {
 public:
   ArchiveReader(const auto_string &path);
   ~ArchiveReader();
   int extractFile(const Path &);
-  int extractFile(const Path &, std::ostream &) noexcept;
+  int extractFile(const Path &, std::ostream &,
+    const Archive::CancelCallback & = {}) noexcept;
 
 private:
-  zipFile m_zip;
+  zipFile open() const;
+  zipFile acquire();
+  void release(zipFile);
+
+  auto_string m_path;
+  WDL_Mutex m_mutex;
+  std::vector<zipFile> m_idle;
 };
 
 typedef std::shared_ptr<ArchiveReader> ArchiveReaderPtr;
@@ -50,7 +70,8 @@ public:
   ArchiveWriter(const auto_string &path);
   ~ArchiveWriter();
   int addFile(const Path &fn);
-  int addFile(const Path &fn, std::istream &) noexcept;
+  int addFile(const Path &fn, std::istream &,
+    const Archive::CancelCallback & = {}) noexcept;
 
 private:
   zipFile m_zip;
@@ -64,6 +85,7 @@ public:
   const TempPath &path() const { return m_path; }
 
   bool concurrent() const override { return false; }
+  bool parallel() const override { return true; }
   void run(DownloadContext *) override;
 
 private:
@@ -0,0 +1,259 @@
+/* ReaPack: Package manager for REAPER
+ * Copyright (C) 2015-2017  Christian Fillion
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef REAPACK_CALLBACK_HPP
+#define REAPACK_CALLBACK_HPP
+
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+template<typename Signature> class Callback;
+
+// Type-erased function object like std::function, storing small functors
+// (such as lambdas capturing a few pointers) inline without allocating.
+template<typename R, typename... Args>
+class Callback<R (Args...)> {
+public:
+  Callback() : m_ops(nullptr) {}
+
+  template<typename F, typename = typename std::enable_if<
+    !std::is_same<typename std::decay<F>::type, Callback>::value>::type>
+  Callback(F &&func)
+  {
+    typedef typename std::decay<F>::type Functor;
+    Ops<Functor>::create(m_buffer, std::forward<F>(func));
+    m_ops = Ops<Functor>::table();
+  }
+
+  Callback(const Callback &o) : m_ops(o.m_ops)
+  {
+    if(m_ops)
+      m_ops->copy(m_buffer, o.m_buffer);
+  }
+
+  Callback(Callback &&o) : m_ops(o.m_ops)
+  {
+    if(m_ops) {
+      m_ops->move(m_buffer, o.m_buffer);
+      o.m_ops = nullptr;
+    }
+  }
+
+  ~Callback() { reset(); }
+
+  Callback &operator=(Callback o)
+  {
+    reset();
+
+    if((m_ops = o.m_ops)) {
+      m_ops->move(m_buffer, o.m_buffer);
+      o.m_ops = nullptr;
+    }
+
+    return *this;
+  }
+
+  void reset()
+  {
+    if(m_ops) {
+      m_ops->destroy(m_buffer);
+      m_ops = nullptr;
+    }
+  }
+
+  explicit operator bool() const { return m_ops != nullptr; }
+
+  R operator()(Args... args) const
+  {
+    return m_ops->invoke(const_cast<char *>(m_buffer), std::forward<Args>(args)...);
+  }
+
+private:
+  static constexpr size_t BUFFER_SIZE = 3 * sizeof(void *);
+
+  struct Table {
+    R (*invoke)(void *, Args &&...);
+    void (*copy)(void *, const void *);
+    void (*move)(void *, void *); // leaves the source destroyed
+    void (*destroy)(void *);
+  };
+
+  template<typename F, bool = sizeof(F) <= BUFFER_SIZE &&
+    alignof(F) <= alignof(std::max_align_t) &&
+    std::is_nothrow_move_constructible<F>::value>
+  struct Ops {
+    template<typename T>
+    static void create(void *b, T &&f) { new (b) F(std::forward<T>(f)); }
+
+    static R invoke(void *b, Args &&...args)
+      { return (*static_cast<F *>(b))(std::forward<Args>(args)...); }
+    static void copy(void *b, const void *o) { new (b) F(*static_cast<const F *>(o)); }
+    static void move(void *b, void *o)
+    {
+      new (b) F(std::move(*static_cast<F *>(o)));
+      destroy(o);
+    }
+    static void destroy(void *b) { static_cast<F *>(b)->~F(); }
+
+    static const Table *table()
+    {
+      static const Table table{invoke, copy, move, destroy};
+      return &table;
+    }
+  };
+
+  // larger functors are stored on the heap, m_buffer holds the pointer
+  template<typename F>
+  struct Ops<F, false> {
+    static F *&ptr(void *b) { return *static_cast<F **>(b); }
+    static F *ptr(const void *b) { return *static_cast<F *const *>(b); }
+
+    template<typename T>
+    static void create(void *b, T &&f) { new (b) F *(new F(std::forward<T>(f))); }
+
+    static R invoke(void *b, Args &&...args)
+      { return (*ptr(b))(std::forward<Args>(args)...); }
+    static void copy(void *b, const void *o) { new (b) F *(new F(*ptr(o))); }
+    static void move(void *b, void *o) { new (b) F *(ptr(o)); }
+    static void destroy(void *b) { delete ptr(b); }
+
+    static const Table *table()
+    {
+      static const Table table{invoke, copy, move, destroy};
+      return &table;
+    }
+  };
+
+  alignas(std::max_align_t) char m_buffer[BUFFER_SIZE];
+  const Table *m_ops;
+};
+
+template<typename Signature, size_t InlineSlots = 6> class Signal;
+
+// Single-threaded replacement for boost::signals2::signal which doesn't
+// allocate for up to InlineSlots small slots. Slots may be connected or
+// disconnected during an emission, but the signal must outlive it.
+template<typename... Args, size_t InlineSlots>
+class Signal<void (Args...), InlineSlots> {
+public:
+  typedef Callback<void (Args...)> slot_type;
+
+  class Connection {
+  public:
+    Connection() : m_signal(nullptr), m_id(0) {}
+    void disconnect() const { if(m_signal) m_signal->disconnect(m_id); }
+
+  private:
+    friend Signal;
+    Connection(Signal *s, const size_t id) : m_signal(s), m_id(id) {}
+
+    Signal *m_signal;
+    size_t m_id;
+  };
+
+  Signal() : m_size(0), m_emitting(0), m_disconnected(false) {}
+  Signal(const Signal &) = delete;
+
+  Connection connect(const slot_type &slot)
+  {
+    const size_t id = m_size++;
+
+    if(id >= InlineSlots) {
+      if(!m_overflow)
+        m_overflow.reset(new std::deque<Slot>);
+
+      // unlike a vector, this does not move the slots that may be running
+      m_overflow->emplace_back();
+    }
+
+    Slot &s = at(id);
+    s.func = slot;
+    s.connected = true;
+
+    return {this, id};
+  }
+
+  void operator()(Args... args)
+  {
+    // slots connected from now on are not called until the next emission
+    const size_t size = m_size;
+
+    m_emitting++;
+    for(size_t i = 0; i < size; i++) {
+      const Slot &slot = at(i);
+      if(slot.connected)
+        slot.func(args...);
+    }
+
+    if(!--m_emitting && m_disconnected)
+      release();
+  }
+
+  void disconnect_all_slots()
+  {
+    for(size_t i = 0; i < m_size; i++)
+      disconnect(i);
+  }
+
+  size_t num_slots() const { return m_size; }
+
+private:
+  struct Slot {
+    Slot() : connected(false) {}
+
+    slot_type func;
+    bool connected;
+  };
+
+  Slot &at(const size_t i)
+  {
+    return i < InlineSlots ? m_inline[i] : (*m_overflow)[i - InlineSlots];
+  }
+
+  void disconnect(const size_t id)
+  {
+    at(id).connected = false;
+    m_disconnected = true;
+
+    // a slot cannot be destroyed while it may be running
+    if(!m_emitting)
+      release();
+  }
+
+  void release()
+  {
+    for(size_t i = 0; i < m_size; i++) {
+      Slot &slot = at(i);
+      if(!slot.connected)
+        slot.func.reset();
+    }
+
+    m_disconnected = false;
+  }
+
+  Slot m_inline[InlineSlots];
+  std::unique_ptr<std::deque<Slot>> m_overflow;
+  size_t m_size;
+  unsigned int m_emitting;
+  bool m_disconnected;
+};
+
+#endif
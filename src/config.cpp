@@ -34,6 +34,8 @@ static const auto_char *INSTALL_GRP = AUTO_STR("install");
 static const auto_char *AUTOINSTALL_KEY = AUTO_STR("autoinstall");
 static const auto_char *PRERELEASES_KEY = AUTO_STR("prereleases");
 static const auto_char *PROMPTOBSOLETE_KEY = AUTO_STR("promptobsolete");
+static const auto_char *MAXCACHESIZE_KEY = AUTO_STR("maxcachesize");
+static const auto_char *WORKERTHREADS_KEY = AUTO_STR("workerthreads");
 
 static const auto_char *ABOUT_GRP = AUTO_STR("about");
 static const auto_char *MANAGER_GRP = AUTO_STR("manager");
@@ -45,6 +47,12 @@ static const auto_char *STATE_KEY = AUTO_STR("state");
 static const auto_char *NETWORK_GRP = AUTO_STR("network");
 static const auto_char *PROXY_KEY = AUTO_STR("proxy");
 static const auto_char *VERIFYPEER_KEY = AUTO_STR("verifypeer");
+static const auto_char *MAXCONNS_KEY = AUTO_STR("maxconnections");
+static const auto_char *MAXHOSTCONNS_KEY = AUTO_STR("maxhostconnections");
+static const auto_char *LOWPRIORITY_KEY = AUTO_STR("lowpriority");
+static const auto_char *RESERVEDCPUS_KEY = AUTO_STR("reservedcpus");
+static const auto_char *MAXRATE_KEY = AUTO_STR("maxrate");
+static const auto_char *PLAYBACKRATE_KEY = AUTO_STR("playbackrate");
 
 static const auto_char *SIZE_KEY = AUTO_STR("size");
 
@@ -67,8 +75,8 @@ Config::Config()
 void Config::resetOptions()
 {
   browser = {true};
-  install = {false, false, true};
-  network = {"", true};
+  install = {false, false, true, 256, 0};
+  network = {"", true, 64, 16, true, "", 0, 0};
   windowState = {};
 }
 
@@ -142,6 +150,10 @@ void Config::read(const Path &path)
     PRERELEASES_KEY, install.bleedingEdge) > 0;
   install.promptObsolete = getUInt(INSTALL_GRP,
     PROMPTOBSOLETE_KEY, install.promptObsolete) > 0;
+  install.maxCacheSize = getUInt(INSTALL_GRP,
+    MAXCACHESIZE_KEY, install.maxCacheSize);
+  install.workerThreads = getUInt(INSTALL_GRP,
+    WORKERTHREADS_KEY, install.workerThreads);
 
   browser.showDescs = getUInt(BROWSER_GRP,
     SHOWDESCS_KEY, browser.showDescs) > 0;
@@ -149,6 +161,17 @@ void Config::read(const Path &path)
   network.proxy = getString(NETWORK_GRP, PROXY_KEY, network.proxy);
   network.verifyPeer = getUInt(NETWORK_GRP,
     VERIFYPEER_KEY, network.verifyPeer) > 0;
+  network.maxConnections = getUInt(NETWORK_GRP,
+    MAXCONNS_KEY, network.maxConnections);
+  network.maxHostConnections = getUInt(NETWORK_GRP,
+    MAXHOSTCONNS_KEY, network.maxHostConnections);
+  network.lowPriority = getUInt(NETWORK_GRP,
+    LOWPRIORITY_KEY, network.lowPriority) > 0;
+  network.reservedCpus = getString(NETWORK_GRP,
+    RESERVEDCPUS_KEY, network.reservedCpus);
+  network.maxRate = getUInt(NETWORK_GRP, MAXRATE_KEY, network.maxRate);
+  network.playbackRate = getUInt(NETWORK_GRP,
+    PLAYBACKRATE_KEY, network.playbackRate);
 
   windowState.about = getString(ABOUT_GRP, STATE_KEY, windowState.about);
   windowState.browser = getString(BROWSER_GRP, STATE_KEY, windowState.browser);
@@ -166,11 +189,19 @@ void Config::write()
   setUInt(INSTALL_GRP, AUTOINSTALL_KEY, install.autoInstall);
   setUInt(INSTALL_GRP, PRERELEASES_KEY, install.bleedingEdge);
   setUInt(INSTALL_GRP, PROMPTOBSOLETE_KEY, install.promptObsolete);
+  setUInt(INSTALL_GRP, MAXCACHESIZE_KEY, install.maxCacheSize);
+  setUInt(INSTALL_GRP, WORKERTHREADS_KEY, install.workerThreads);
 
   setUInt(BROWSER_GRP, SHOWDESCS_KEY, browser.showDescs);
 
   setString(NETWORK_GRP, PROXY_KEY, network.proxy);
   setUInt(NETWORK_GRP, VERIFYPEER_KEY, network.verifyPeer);
+  setUInt(NETWORK_GRP, MAXCONNS_KEY, network.maxConnections);
+  setUInt(NETWORK_GRP, MAXHOSTCONNS_KEY, network.maxHostConnections);
+  setUInt(NETWORK_GRP, LOWPRIORITY_KEY, network.lowPriority);
+  setString(NETWORK_GRP, RESERVEDCPUS_KEY, network.reservedCpus);
+  setUInt(NETWORK_GRP, MAXRATE_KEY, network.maxRate);
+  setUInt(NETWORK_GRP, PLAYBACKRATE_KEY, network.playbackRate);
 
   setString(ABOUT_GRP, STATE_KEY, windowState.about);
   setString(BROWSER_GRP, STATE_KEY, windowState.browser);
@@ -39,11 +39,19 @@ struct InstallOpts {
   bool autoInstall;
   bool bleedingEdge;
   bool promptObsolete;
+  unsigned int maxCacheSize; // in MiB
+  unsigned int workerThreads; // 0 for one per CPU core
 };
 
 struct NetworkOpts {
   std::string proxy;
   bool verifyPeer;
+  unsigned int maxConnections;
+  unsigned int maxHostConnections;
+  bool lowPriority; // run the workers as background threads
+  std::string reservedCpus; // CPU cores kept free for REAPER, eg. "0,2-3"
+  unsigned int maxRate; // KiB/s shared by every download, 0 for unlimited
+  unsigned int playbackRate; // same while REAPER is playing or recording
 };
 
 class Config {
@@ -17,95 +17,169 @@
 
 #include "download.hpp"
 
+#include "filecache.hpp"
 #include "filesystem.hpp"
-#include "reapack.hpp"
+#include "hash.hpp"
+#include "journal.hpp"
 
-#include <boost/format.hpp>
+#include <boost/algorithm/string.hpp>
 
-#include <reaper_plugin_functions.h>
+#include <algorithm>
+#include <ctime>
+#include <stdexcept>
 
-using boost::format;
 using namespace std;
 
-static const int DOWNLOAD_TIMEOUT = 15;
-// to set the amount of concurrent downloads, change the size of
-// the m_pool member in ThreadPool (thread.hpp)
+// maximum time spent waiting for network activity before
+// checking for aborted transfers again
+static const int POLL_TIMEOUT = 1000;
 
-static CURLSH *g_curlShare = nullptr;
-static WDL_Mutex g_curlMutex;
+// files larger than this are fetched with several ranged requests at once
+static const int64_t SEGMENT_SIZE = 4 << 20;
+static const int MAX_SEGMENTS = 4;
 
-static void LockCurlMutex(CURL *, curl_lock_data, curl_lock_access, void *)
+// partial downloads not resumed within a week are removed
+static const time_t PARTIAL_MAX_AGE = 7 * 24 * 60 * 60;
+
+static DownloadContext::Order g_order = DownloadContext::LargestFirst;
+
+void DownloadContext::GlobalInit()
 {
-  g_curlMutex.Enter();
+  CurlTransport::GlobalInit();
 }
 
-static void UnlockCurlMutex(CURL *, curl_lock_data, curl_lock_access, void *)
+void DownloadContext::GlobalCleanup()
 {
-  g_curlMutex.Leave();
+  CurlTransport::GlobalCleanup();
 }
 
-void DownloadContext::GlobalInit()
+void DownloadContext::setOrder(const Order order)
 {
-  curl_global_init(CURL_GLOBAL_DEFAULT);
-
-  g_curlShare = curl_share_init();
-  assert(g_curlShare);
-
-  curl_share_setopt(g_curlShare, CURLSHOPT_LOCKFUNC, LockCurlMutex);
-  curl_share_setopt(g_curlShare, CURLSHOPT_UNLOCKFUNC, UnlockCurlMutex);
+  g_order = order;
+}
 
-  curl_share_setopt(g_curlShare, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
-  curl_share_setopt(g_curlShare, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+DownloadContext::DownloadContext()
+  : m_transport(Transport::create()), m_serial(0)
+{
+  m_transport->setContext(this);
 }
 
-void DownloadContext::GlobalCleanup()
+DownloadContext::~DownloadContext()
 {
-  curl_share_cleanup(g_curlShare);
-  curl_global_cleanup();
+  // transfers still running at this point are left unfinished
+  for(Download *dl : m_downloads) {
+    for(const auto &transfer : dl->m_transfers)
+      m_transport->remove(transfer.get());
+  }
 }
 
-DownloadContext::DownloadContext()
+void DownloadContext::queue(Download *dl)
 {
-  m_curl = curl_easy_init();
+  int64_t priority;
+
+  switch(g_order) {
+  case LargestFirst:
+    priority = dl->expectedSize();
+    break;
+  case SmallestFirst:
+    priority = -dl->expectedSize();
+    break;
+  default:
+    priority = 0;
+    break;
+  }
 
-  const auto userAgent = format("ReaPack/%s REAPER/%s")
-    % ReaPack::VERSION % GetAppVersion();
+  m_queue.push({dl, priority, m_serial++});
+}
+
+void DownloadContext::startQueued()
+{
+  while(!m_queue.empty()) {
+    Download *dl = m_queue.top().download;
+
+    if(dl->aborted()) {
+      m_queue.pop();
+      dl->finish(ThreadTask::Aborted, {"cancelled", dl->url()});
+      continue;
+    }
+
+    // curl would queue the extra connections in the order they were added
+    const unsigned int limit = dl->options().maxConnections;
+    if(limit && m_downloads.size() >= limit)
+      break;
+
+    m_queue.pop();
+    dl->m_startTime = chrono::steady_clock::now();
+    dl->startTransfer();
+  }
+}
 
-  curl_easy_setopt(m_curl, CURLOPT_USERAGENT, userAgent.str().c_str());
-  curl_easy_setopt(m_curl, CURLOPT_LOW_SPEED_LIMIT, 1);
-  curl_easy_setopt(m_curl, CURLOPT_LOW_SPEED_TIME, DOWNLOAD_TIMEOUT);
-  curl_easy_setopt(m_curl, CURLOPT_CONNECTTIMEOUT, DOWNLOAD_TIMEOUT);
-  curl_easy_setopt(m_curl, CURLOPT_FOLLOWLOCATION, true);
-  curl_easy_setopt(m_curl, CURLOPT_MAXREDIRS, 5);
-  curl_easy_setopt(m_curl, CURLOPT_ACCEPT_ENCODING, "");
-  curl_easy_setopt(m_curl, CURLOPT_FAILONERROR, true);
-  curl_easy_setopt(m_curl, CURLOPT_SHARE, g_curlShare);
-  curl_easy_setopt(m_curl, CURLOPT_NOPROGRESS, false);
+void DownloadContext::add(Transfer *transfer)
+{
+  m_transport->add(transfer);
+  m_downloads.insert(transfer->download);
 }
 
-DownloadContext::~DownloadContext()
+void DownloadContext::complete(Transfer *transfer)
 {
-  curl_easy_cleanup(m_curl);
+  Download *dl = transfer->download;
+
+  if(dl->complete(transfer))
+    m_downloads.erase(dl);
 }
 
-size_t Download::WriteData(char *data, size_t rawsize, size_t nmemb, void *ptr)
+void DownloadContext::perform()
 {
-  const size_t size = rawsize * nmemb;
+  startQueued();
+  m_transport->perform();
+
+  // transfers waiting for a connection never report their progress
+  for(auto it = m_downloads.begin(); it != m_downloads.end();) {
+    Download *dl = *it;
 
-  static_cast<ostream *>(ptr)->write(data, size);
+    if(dl->aborted()) {
+      Transfer *transfer;
 
-  return size;
+      do {
+        transfer = dl->m_transfers.back().get();
+        m_transport->remove(transfer);
+      } while(!dl->complete(transfer));
+
+      it = m_downloads.erase(it);
+      continue;
+    }
+    // transfers cannot be added from within the write callback
+    else if(dl->m_length > 0 && !dl->m_segmented)
+      dl->startSegments();
+
+    it++;
+  }
+
+  if(!idle())
+    m_transport->poll(POLL_TIMEOUT);
+}
+
+void DownloadContext::wakeup()
+{
+  m_transport->wakeup();
 }
 
-int Download::UpdateProgress(void *ptr, const double, const double,
-    const double, const double)
+void DownloadContext::dispatch(ThreadTask *task)
 {
-  return static_cast<Download *>(ptr)->aborted();
+  if(m_dispatcher)
+    m_dispatcher(task);
+  else
+    task->run(nullptr);
 }
 
 Download::Download(const string &url, const NetworkOpts &opts, const int flags)
-  : m_url(url), m_opts(opts), m_flags(flags)
+  : m_url(url), m_opts(opts), m_flags(flags), m_expectedSize(0),
+    m_resumeFrom(0), m_rangeRejected(false), m_context(nullptr),
+    m_output(nullptr), m_outputPos(0), m_length(0), m_segmented(false),
+    m_doneReceived(0), m_doneExpected(0), m_firstByte(-1), m_responseCode(0)
 {
+  if(has(NoCacheFlag))
+    addHeader("Cache-Control: no-cache");
 }
 
 void Download::setName(const string &name)
@@ -113,11 +187,25 @@ void Download::setName(const string &name)
   setSummary("Downloading %s: " + name);
 }
 
-void Download::start()
+void Download::addHeader(const string &header)
+{
+  m_requestHeaders.push_back(header);
+}
+
+void Download::resumeFrom(const int64_t offset, const string &validator)
+{
+  m_resumeFrom = offset;
+  m_ifRange = validator;
+}
+
+string Download::responseHeader(const string &name) const
 {
-  WorkerThread *thread = new WorkerThread;
-  thread->push(this);
-  onFinish([thread] { delete thread; });
+  const auto it = m_responseHeaders.find(boost::algorithm::to_lower_copy(name));
+
+  if(it == m_responseHeaders.end())
+    return {};
+  else
+    return it->second;
 }
 
 void Download::run(DownloadContext *ctx)
@@ -129,41 +217,218 @@ void Download::run(DownloadContext *ctx)
 
   ThreadNotifier::get()->notify({this, Running});
 
-  ostream *stream = openStream();
-  if(!stream)
+  m_context = ctx;
+  ctx->queue(this);
+}
+
+void Download::abort()
+{
+  ThreadTask::abort();
+
+  // don't wait for the next network activity or the poll timeout
+  if(DownloadContext *ctx = m_context)
+    ctx->wakeup();
+}
+
+void Download::startTransfer()
+{
+  m_output = openStream();
+  if(!m_output)
+    return;
+
+  m_outputPos = 0;
+  m_length = 0;
+  m_segmented = false;
+  m_error.clear();
+  m_doneReceived = m_doneExpected = 0;
+  m_responseHeaders.clear();
+
+  if(m_resumeFrom > 0)
+    createTransfer(m_url, true, to_string(m_resumeFrom) + "-", m_ifRange);
+  else if(has(SegmentedFlag)) {
+    // the size of the file is unknown until the first segment arrives
+    createTransfer(m_url, true, "0-" + to_string(SEGMENT_SIZE - 1), {});
+  }
+  else
+    createTransfer(m_url, true, {}, {});
+}
+
+Transfer *Download::createTransfer(const string &url, const bool primary,
+    const string &range, const string &ifRange)
+{
+  Transfer *transfer = new Transfer{this, url, m_requestHeaders, range, primary,
+    0, {}, 0, 0, {}, false, primary ? 0 : stoll(range), nullptr};
+  m_transfers.emplace_back(transfer);
+
+  if(!ifRange.empty())
+    transfer->headers.push_back("If-Range: " + ifRange);
+
+  m_context.load()->add(transfer);
+
+  return transfer;
+}
+
+void Download::startSegments()
+{
+  m_segmented = true;
+
+  // reserve the whole file so the segments can be written in any order
+  m_output->seekp(m_length - 1);
+  m_output->put(0);
+  m_outputPos = m_length;
+
+  // make sure every segment comes from the same version of the file
+  const string &etag = responseHeader("ETag");
+  const string &ifRange = etag.empty() || boost::algorithm::starts_with(etag, "W/")
+    ? responseHeader("Last-Modified") : etag;
+
+  const int64_t remaining = m_length - SEGMENT_SIZE;
+  const int64_t count = min<int64_t>(MAX_SEGMENTS - 1,
+    (remaining + SEGMENT_SIZE - 1) / SEGMENT_SIZE);
+
+  for(int64_t i = 0; i < count; i++) {
+    const int64_t begin = SEGMENT_SIZE + remaining * i / count;
+    const int64_t end = SEGMENT_SIZE + remaining * (i + 1) / count;
+
+    createTransfer(m_effectiveUrl, false,
+      to_string(begin) + "-" + to_string(end - 1), ifRange);
+  }
+}
+
+bool Download::write(Transfer *transfer, const char *data, const size_t size)
+{
+  if(!transfer->receiving) {
+    transfer->receiving = true;
+
+    if(m_firstByte < 0) {
+      const chrono::duration<double> elapsed = chrono::steady_clock::now() - m_startTime;
+      m_firstByte = elapsed.count();
+    }
+
+    const long code = transfer->responseCode;
+
+    if(!transfer->primary && code != 206) {
+      if(m_error.empty())
+        m_error = "the file changed during the download";
+      return false;
+    }
+    // the server ignored the range or the resource has changed
+    else if(m_resumeFrom > 0 && code != 206) {
+      m_rangeRejected = true;
+      return false;
+    }
+    else if(has(SegmentedFlag) && !m_resumeFrom && code == 206) {
+      const string &range = responseHeader("Content-Range");
+
+      int64_t length = 0;
+      try { length = stoll(range.substr(range.find('/') + 1)); }
+      catch(const logic_error &) {}
+
+      if(length > SEGMENT_SIZE) {
+        m_effectiveUrl = transfer->effectiveUrl;
+        m_length = length;
+      }
+      // the rest of the file could not be requested without its size
+      else if(length <= 0) {
+        m_flags &= ~SegmentedFlag;
+        m_rangeRejected = true;
+        return false;
+      }
+    }
+  }
+
+  if(transfer->offset != m_outputPos)
+    m_output->seekp(transfer->offset);
+
+  m_output->write(data, size);
+
+  transfer->offset += size;
+  m_outputPos = transfer->offset;
+
+  return true;
+}
+
+void Download::readHeader(const string &line)
+{
+  // each response of a redirection chain starts with a status line
+  if(boost::algorithm::starts_with(line, "HTTP/")) {
+    m_responseHeaders.clear();
+    return;
+  }
+
+  const size_t colon = line.find(':');
+  if(colon == string::npos)
     return;
 
-  curl_easy_setopt(ctx->m_curl, CURLOPT_URL, m_url.c_str());
-  curl_easy_setopt(ctx->m_curl, CURLOPT_PROXY, m_opts.proxy.c_str());
-  curl_easy_setopt(ctx->m_curl, CURLOPT_SSL_VERIFYPEER, m_opts.verifyPeer);
+  const string &name = boost::algorithm::to_lower_copy(line.substr(0, colon));
+  const string &value = boost::algorithm::trim_copy(line.substr(colon + 1));
+  m_responseHeaders[name] = value;
+}
+
+bool Download::progress()
+{
+  updateMetrics();
+
+  // a failed segment stops the other ones
+  return !aborted() && m_error.empty();
+}
 
-  curl_easy_setopt(ctx->m_curl, CURLOPT_PROGRESSFUNCTION, UpdateProgress);
-  curl_easy_setopt(ctx->m_curl, CURLOPT_PROGRESSDATA, this);
+void Download::updateMetrics()
+{
+  int64_t received = m_doneReceived, expected = m_doneExpected;
 
-  curl_easy_setopt(ctx->m_curl, CURLOPT_WRITEFUNCTION, WriteData);
-  curl_easy_setopt(ctx->m_curl, CURLOPT_WRITEDATA, stream);
+  for(const auto &transfer : m_transfers) {
+    received += transfer->received;
+    expected += transfer->expected;
+  }
 
-  curl_slist *headers = nullptr;
-  if(has(Download::NoCacheFlag))
-    headers = curl_slist_append(headers, "Cache-Control: no-cache");
-  curl_easy_setopt(ctx->m_curl, CURLOPT_HTTPHEADER, headers);
+  setBytes(received, expected);
 
-  char errbuf[CURL_ERROR_SIZE] = "No details";
-  curl_easy_setopt(ctx->m_curl, CURLOPT_ERRORBUFFER, errbuf);
+  const chrono::duration<double> elapsed = chrono::steady_clock::now() - m_startTime;
+  setTimes(max(m_firstByte, 0.0), elapsed.count());
+}
 
-  const CURLcode res = curl_easy_perform(ctx->m_curl);
-  closeStream();
+bool Download::complete(Transfer *transfer)
+{
+  if(transfer->primary)
+    m_responseCode = transfer->responseCode;
 
-  if(aborted())
-    finish(Aborted, {"aborted", m_url});
-  else if(res != CURLE_OK) {
-    const auto err = format("%s (%d): %s") % curl_easy_strerror(res) % res % errbuf;
-    finish(Failure, {err.str(), m_url});
+  if(!transfer->error.empty() && m_error.empty())
+    m_error = transfer->error;
+
+  const bool restart = transfer->primary &&
+    m_rangeRejected && !transfer->range.empty() && !aborted();
+
+  m_doneReceived += transfer->received;
+  m_doneExpected += max(transfer->received, transfer->expected);
+
+  m_transfers.erase(find_if(m_transfers.begin(), m_transfers.end(),
+    [=](const unique_ptr<Transfer> &t) { return t.get() == transfer; }));
+
+  if(restart) {
+    // start over, the partial data cannot be used anymore
+    m_resumeFrom = 0;
+    startTransfer();
+    return m_transfers.empty();
   }
+  else if(m_length > 0 && !m_segmented && m_error.empty() && !aborted())
+    startSegments();
+
+  if(!m_transfers.empty())
+    return false;
+
+  updateMetrics();
+
+  if(!closeStream(m_error.empty() && !aborted()))
+    m_context.load()->dispatch(this);
+  else if(aborted())
+    finish(Aborted, {"aborted", m_url});
+  else if(!m_error.empty())
+    finish(Failure, {m_error, m_url});
   else
     finish(Success);
 
-  curl_slist_free_all(headers);
+  return true;
 }
 
 MemoryDownload::MemoryDownload(const string &url, const NetworkOpts &opts, int flags)
@@ -172,31 +437,323 @@ MemoryDownload::MemoryDownload(const string &url, const NetworkOpts &opts, int f
   setName(url);
 }
 
+static bool ReadFields(const Path &path, map<string, string> *fields)
+{
+  ifstream stream;
+  if(!FS::open(stream, path))
+    return false;
+
+  string line;
+  while(getline(stream, line)) {
+    const size_t colon = line.find(':');
+    if(colon == string::npos)
+      continue;
+
+    const string &name = line.substr(0, colon);
+    (*fields)[name] = boost::algorithm::trim_copy(line.substr(colon + 1));
+  }
+
+  return true;
+}
+
+static Path PartialDir()
+{
+  return Path::CACHE + "partial";
+}
+
+Path FileDownload::validatorsPathFor(const Path &target)
+{
+  Path path(target);
+  path[path.size() - 1] += ".headers";
+  return path;
+}
+
+Path FileDownload::partialPathFor(const Path &temp)
+{
+  Hash hash;
+  hash.addData(temp.join());
+  return PartialDir() + hash.digest();
+}
+
+bool FileDownload::discard(const TempPath &path)
+{
+  const Path &resumePath = validatorsPathFor(path.temp());
+
+  if(FS::exists(resumePath)) {
+    // out of the way of the installed files, where expirePartials finds it
+    const Path &partial = partialPathFor(path.temp());
+    FS::mkdir(PartialDir());
+
+    if(FS::rename(resumePath, validatorsPathFor(partial)) &&
+        FS::rename(path.temp(), partial))
+      return true;
+
+    FS::remove(resumePath);
+  }
+
+  return FS::removeRecursive(path.temp());
+}
+
+void FileDownload::expirePartials()
+{
+  const Path &dir = PartialDir();
+
+  map<string, FS::Stat> files;
+  if(!FS::list(dir, &files))
+    return;
+
+  const time_t now = time(nullptr);
+
+  for(const auto &pair : files) {
+    const Path &path = dir + pair.first;
+    time_t mtime;
+
+    // the partial file goes along with its validators
+    if(boost::algorithm::ends_with(pair.first, ".headers") ||
+        (FS::mtime(validatorsPathFor(path), &mtime) &&
+         now - mtime < PARTIAL_MAX_AGE && now >= mtime))
+      continue;
+
+    FS::remove(path);
+    FS::remove(validatorsPathFor(path));
+  }
+}
+
 FileDownload::FileDownload(const Path &target, const string &url,
     const NetworkOpts &opts, int flags)
-  : Download(url, opts, flags), m_path(target)
+  : Download(url, opts, flags), m_path(target), m_cache(nullptr),
+    m_journal(nullptr), m_reused(false), m_received(false)
 {
   setName(target.join());
+
+  // the previous version of the file is a good guess
+  int64_t size;
+  if(FS::size(target, &size))
+    setExpectedSize(size);
+
+  if(has(ConditionalFlag))
+    readValidators();
+}
+
+bool FileDownload::reuse(const FileDownload &other)
+{
+  FS::remove(m_path.temp());
+
+  // not linked: the two targets must stay independent files
+  m_reused = FS::copy(other.path().temp(), m_path.temp());
+  return m_reused;
 }
 
 bool FileDownload::save()
 {
-  if(state() == Success)
-    return FS::rename(m_path);
-  else
-    return FS::remove(m_path.temp());
+  if(state() != Success)
+    return discard(m_path);
+  else if(notModified()) {
+    // keep the current file, only remember when it was last revalidated
+    FS::remove(m_path.temp());
+    return writeValidators();
+  }
+  else if(!FS::rename(m_path))
+    return false;
+
+  return !has(ConditionalFlag) || writeValidators();
+}
+
+void FileDownload::readValidators()
+{
+  const Path &path = validatorsPathFor(m_path.target());
+
+  // ignore the validators if the file was modified by something else since
+  time_t targetTime, validatorsTime;
+  if(!FS::mtime(m_path.target(), &targetTime) ||
+      !FS::mtime(path, &validatorsTime) || validatorsTime < targetTime)
+    return;
+
+  map<string, string> fields;
+  if(!ReadFields(path, &fields))
+    return;
+
+  m_etag = fields["ETag"];
+  m_lastModified = fields["Last-Modified"];
+
+  if(!m_etag.empty())
+    addHeader("If-None-Match: " + m_etag);
+  if(!m_lastModified.empty())
+    addHeader("If-Modified-Since: " + m_lastModified);
+}
+
+bool FileDownload::writeValidators()
+{
+  // a 304 response may omit the validators which are still valid
+  const string &etag = responseHeader("ETag");
+  if(!etag.empty() || !notModified())
+    m_etag = etag;
+
+  const string &lastModified = responseHeader("Last-Modified");
+  if(!lastModified.empty() || !notModified())
+    m_lastModified = lastModified;
+
+  const Path &path = validatorsPathFor(m_path.target());
+
+  if(m_etag.empty() && m_lastModified.empty())
+    return !FS::exists(path) || FS::remove(path);
+
+  ostringstream stream;
+  if(!m_etag.empty())
+    stream << "ETag: " << m_etag << '\n';
+  if(!m_lastModified.empty())
+    stream << "Last-Modified: " << m_lastModified << '\n';
+
+  return FS::write(path, stream.str());
 }
 
 ostream *FileDownload::openStream()
 {
-  if(FS::open(m_stream, m_path.temp()))
+  // the server refused to resume the previous partial transfer
+  if(m_stream.is_open())
+    m_stream.close();
+
+  const Path &resumePath = validatorsPathFor(m_path.temp());
+  map<string, string> fields;
+  int64_t size = 0;
+
+  // put back the partial file left by a previous attempt
+  const Path &partial = partialPathFor(m_path.temp());
+  if(FS::exists(validatorsPathFor(partial))) {
+    if(!FS::rename(partial, m_path.temp()) ||
+        !FS::rename(validatorsPathFor(partial), resumePath)) {
+      FS::remove(partial);
+      FS::remove(validatorsPathFor(partial));
+    }
+  }
+
+  if(!has(ConditionalFlag) && !rangeRejected() &&
+      ReadFields(resumePath, &fields) && FS::size(m_path.temp(), &size)) {
+    const string &validator = fields["ETag"].empty() ?
+      fields["Last-Modified"] : fields["ETag"];
+
+    int64_t length = 0;
+    try { length = stoll(fields["Content-Length"]); }
+    catch(const logic_error &) {}
+
+    // a partial file as large as the whole resource is not to be trusted
+    if(size > 0 && !validator.empty() && (length <= 0 || size < length))
+      resumeFrom(size, validator);
+  }
+
+  if(!resumeOffset() && FS::exists(resumePath))
+    FS::remove(resumePath);
+
+  if(FS::open(m_stream, m_path.temp(), resumeOffset() > 0))
     return &m_stream;
 
   finish(Failure, {FS::lastError(), m_path.temp().join()});
   return nullptr;
 }
 
-void FileDownload::closeStream()
+void FileDownload::run(DownloadContext *ctx)
+{
+  if(m_received) {
+    if(aborted())
+      finish(Aborted, {"aborted", url()});
+    else {
+      store();
+      finish(Success);
+    }
+
+    return;
+  }
+
+  // completed by an interrupted transaction or found in the cache
+  if(aborted() || (!m_reused &&
+      (!m_journal || !m_journal->fetch(url(), m_path)) &&
+      (!m_cache || !m_cache->fetch(url(), m_cacheVersion, m_path.temp())))) {
+    Download::run(ctx);
+    return;
+  }
+
+  ThreadNotifier::get()->notify({this, Running});
+  finish(Success);
+}
+
+bool FileDownload::closeStream(const bool success)
 {
   m_stream.close();
+
+  if(!success) {
+    writeResumeInfo();
+    return true;
+  }
+
+  const Path &resumePath = validatorsPathFor(m_path.temp());
+  if(FS::exists(resumePath))
+    FS::remove(resumePath);
+
+  if(!m_journal && (!m_cache || notModified()))
+    return true;
+
+  // don't hold up the other transfers while hashing the file
+  m_received = true;
+  return false;
+}
+
+void FileDownload::store()
+{
+  // hashed once for both the journal and the cache
+  ifstream stream;
+  string hash;
+  int64_t size;
+  if(!FS::open(stream, m_path.temp()) || !Hash::file(stream, &hash, &size))
+    return;
+
+  stream.close();
+
+  if(m_cache && !notModified())
+    m_cache->store(url(), m_cacheVersion, m_path.temp(), hash, size);
+
+  if(m_journal)
+    m_journal->addDownload(url(), m_path, hash);
+}
+
+bool FileDownload::canResume() const
+{
+  if(has(ConditionalFlag) || segmented() ||
+      !responseHeader("Content-Encoding").empty())
+    return false;
+  else if(responseCode() != 206 && responseHeader("Accept-Ranges") != "bytes")
+    return false;
+
+  // If-Range only accepts strong entity tags
+  const string &etag = responseHeader("ETag");
+  return (!etag.empty() && !boost::algorithm::starts_with(etag, "W/")) ||
+    !responseHeader("Last-Modified").empty();
+}
+
+bool FileDownload::writeResumeInfo()
+{
+  const Path &path = validatorsPathFor(m_path.temp());
+
+  // no response at all: keep what is known about the previous attempt
+  if(!responseCode() && resumeOffset() > 0)
+    return true;
+  else if(!canResume())
+    return !FS::exists(path) || FS::remove(path);
+
+  // the length of the whole resource, not only of the requested range
+  string length = responseHeader("Content-Length");
+  const string &range = responseHeader("Content-Range");
+  if(responseCode() == 206)
+    length = range.substr(range.find('/') + 1);
+
+  const string &etag = responseHeader("ETag");
+
+  ostringstream stream;
+  if(!boost::algorithm::starts_with(etag, "W/") && !etag.empty())
+    stream << "ETag: " << etag << '\n';
+  if(!responseHeader("Last-Modified").empty())
+    stream << "Last-Modified: " << responseHeader("Last-Modified") << '\n';
+  if(!length.empty() && length != "*")
+    stream << "Content-Length: " << length << '\n';
+
+  return FS::write(path, stream.str());
 }
@@ -21,49 +21,157 @@
 #include "config.hpp"
 #include "path.hpp"
 #include "thread.hpp"
+#include "transport.hpp"
 
+#include <atomic>
+#include <chrono>
 #include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <queue>
 #include <sstream>
+#include <unordered_set>
+#include <vector>
 
-#include <curl/curl.h>
+class FileCache;
+class Journal;
+
+// Runs every transfer started from one worker thread through a single transport.
+class DownloadContext {
+public:
+  // which queued download is started first when a connection frees up
+  enum Order {
+    FifoOrder,
+    LargestFirst, // shortest total time: no large file is left for the end
+    SmallestFirst, // most files done early
+  };
 
-struct DownloadContext {
   static void GlobalInit();
   static void GlobalCleanup();
+  static void setOrder(Order);
 
   DownloadContext();
   ~DownloadContext();
 
-  CURL *m_curl;
+  void queue(Download *);
+  void add(Transfer *);
+  void complete(Transfer *);
+  void perform();
+  void wakeup();
+  bool idle() const { return m_downloads.empty() && m_queue.empty(); }
+
+  // runs the tasks given by finished downloads out of the event loop,
+  // or right away without a dispatcher
+  typedef std::function<void (ThreadTask *)> Dispatcher;
+  void setDispatcher(const Dispatcher &d) { m_dispatcher = d; }
+  void dispatch(ThreadTask *);
+
+private:
+  struct Queued {
+    Download *download;
+    int64_t priority;
+    uint64_t serial;
+
+    bool operator<(const Queued &o) const
+    {
+      return priority < o.priority || (priority == o.priority && serial > o.serial);
+    }
+  };
+
+  void startQueued();
+
+  std::unique_ptr<Transport> m_transport;
+  Dispatcher m_dispatcher;
+  std::unordered_set<Download *> m_downloads;
+  std::priority_queue<Queued> m_queue;
+  uint64_t m_serial;
 };
 
 class Download : public ThreadTask {
 public:
   enum Flag {
-    NoCacheFlag = 1<<0,
+    NoCacheFlag     = 1<<0,
+    ConditionalFlag = 1<<1,
+    SegmentedFlag   = 1<<2,
   };
 
   Download(const std::string &url, const NetworkOpts &, int flags = 0);
 
   void setName(const std::string &);
   const std::string &url() const { return m_url; }
-  void start();
+
+  const NetworkOpts &options() const { return m_opts; }
+  void addHeader(const std::string &);
+  // in bytes, 0 if unknown
+  void setExpectedSize(int64_t size) { m_expectedSize = size; }
+  int64_t expectedSize() const { return m_expectedSize; }
+
+  long responseCode() const { return m_responseCode; }
+  std::string responseHeader(const std::string &name) const;
+  bool notModified() const { return m_responseCode == 304; }
 
   bool concurrent() const override { return true; }
   void run(DownloadContext *) override;
+  void abort() override;
+
+protected:
+  bool has(Flag f) const { return (m_flags & f) != 0; }
+
+  // request only the bytes following offset if the resource still matches
+  // the validator (ETag or Last-Modified), otherwise get the whole thing
+  void resumeFrom(int64_t offset, const std::string &validator);
+  int64_t resumeOffset() const { return m_resumeFrom; }
+  bool rangeRejected() const { return m_rangeRejected; }
+  bool segmented() const { return m_segmented; }
 
 private:
+  // may be called a second time before closeStream if the server
+  // sent the whole resource instead of the requested range
   virtual std::ostream *openStream() = 0;
-  virtual void closeStream() {}
+  // returns false to finish the download from DownloadContext::dispatch
+  virtual bool closeStream(bool success) { return true; }
 
 private:
-  bool has(Flag f) const { return (m_flags & f) != 0; }
-  static size_t WriteData(char *, size_t, size_t, void *);
-  static int UpdateProgress(void *, double, double, double, double);
+  friend DownloadContext;
+  friend Transport;
+
+  void startTransfer();
+  Transfer *createTransfer(const std::string &url, bool primary,
+    const std::string &range, const std::string &ifRange);
+  void startSegments();
+  bool write(Transfer *, const char *, size_t);
+  void readHeader(const std::string &line);
+  bool progress();
+  bool complete(Transfer *);
+  void updateMetrics();
 
   std::string m_url;
   NetworkOpts m_opts;
   int m_flags;
+  int64_t m_expectedSize;
+  std::vector<std::string> m_requestHeaders;
+  int64_t m_resumeFrom;
+  std::string m_ifRange;
+  bool m_rangeRejected;
+
+  std::atomic<DownloadContext *> m_context; // set once running
+  std::ostream *m_output;
+  int64_t m_outputPos;
+  std::vector<std::unique_ptr<Transfer>> m_transfers;
+  std::string m_effectiveUrl;
+  int64_t m_length; // set when the rest of the file is to be fetched in segments
+  bool m_segmented;
+  std::string m_error; // of the first failed transfer
+
+  // bytes of the transfers that already completed
+  int64_t m_doneReceived;
+  int64_t m_doneExpected;
+  std::chrono::steady_clock::time_point m_startTime;
+  double m_firstByte;
+
+  long m_responseCode;
+  std::map<std::string, std::string> m_responseHeaders;
 };
 
 class MemoryDownload : public Download {
@@ -81,19 +189,51 @@ private:
 
 class FileDownload : public Download {
 public:
+  static Path validatorsPathFor(const Path &target);
+  // where a partial download is kept until the next attempt
+  static Path partialPathFor(const Path &temp);
+  // removes the temporary file unless it is a partial download to resume later
+  static bool discard(const TempPath &);
+  // removes the partial downloads that were not resumed for a while
+  static void expirePartials();
+
   FileDownload(const Path &target, const std::string &url,
     const NetworkOpts &, int flags = 0);
 
   const TempPath &path() const { return m_path; }
+  // for downloading the same target more than once at a time
+  void setPath(const TempPath &path) { m_path = path; }
+  // the cached files are looked up by URL and by the version they belong to
+  void setCache(FileCache *cache, const std::string &version)
+  { m_cache = cache; m_cacheVersion = version; }
+  void setJournal(Journal *journal) { m_journal = journal; }
+  // take the file fetched by another download of the same URL
+  bool reuse(const FileDownload &);
   bool save();
 
+  void run(DownloadContext *) override;
+
 protected:
   std::ostream *openStream() override;
-  void closeStream() override;
+  bool closeStream(bool success) override;
 
 private:
+  void store();
+  void readValidators();
+  bool writeValidators();
+  bool canResume() const;
+  bool writeResumeInfo();
+
   TempPath m_path;
   std::ofstream m_stream;
+  FileCache *m_cache;
+  std::string m_cacheVersion;
+  Journal *m_journal;
+  bool m_reused;
+  bool m_received; // hashed by a parallel worker
+
+  std::string m_etag;
+  std::string m_lastModified;
 };
 
 #endif
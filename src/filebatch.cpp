@@ -0,0 +1,105 @@
+/* ReaPack: Package manager for REAPER
+ * Copyright (C) 2015-2017  Christian Fillion
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "filebatch.hpp"
+
+#include "download.hpp"
+#include "filesystem.hpp"
+
+using namespace std;
+
+FileBatch::FileBatch()
+{
+  setSummary("Committing %s: moving files into place");
+
+  onFinish([this] {
+    for(const Item &item : m_items)
+      item.callback(item.result);
+  });
+}
+
+void FileBatch::add(const Changes &changes, const Callback &callback)
+{
+  m_items.push_back({changes, callback, {Cancelled}});
+}
+
+void FileBatch::run(DownloadContext *)
+{
+  ThreadNotifier::get()->notify({this, Running});
+
+  for(Item &item : m_items) {
+    // the changes of a package are not interrupted midway
+    if(aborted())
+      discard(&item);
+    else
+      apply(&item);
+  }
+
+  if(aborted())
+    finish(Aborted, {"cancelled", "file operations"});
+  else
+    finish(Success);
+}
+
+void FileBatch::apply(Item *item)
+{
+  Result &result = item->result;
+
+  for(const TempPath &paths : item->changes.renames) {
+    if(!FS::rename(paths)) {
+      result.status = Failed;
+      result.error = {FS::lastError(), paths.target().join()};
+
+      // it's a bit late to rollback here as some files might already have been
+      // overwritten. at least we can delete the temporary files
+      for(const TempPath &other : item->changes.renames)
+        FileDownload::discard(other);
+
+      return;
+    }
+  }
+
+  result.status = Committed;
+
+  for(const TempPath &paths : item->changes.renames) {
+    FS::Stat st{-1};
+    FS::stat(paths.target(), &st);
+    result.renamed.push_back(st);
+  }
+
+  for(const Path &path : item->changes.removals) {
+    Removal removal{FS::exists(path), false};
+
+    if(removal.existed) {
+      removal.removed = item->changes.recursive ?
+        FS::removeRecursive(path) : FS::remove(path);
+
+      if(!removal.removed)
+        removal.error = FS::lastError();
+    }
+
+    result.removals.push_back(removal);
+  }
+}
+
+void FileBatch::discard(Item *item)
+{
+  item->result.status = Cancelled;
+
+  for(const TempPath &paths : item->changes.renames)
+    FileDownload::discard(paths);
+}
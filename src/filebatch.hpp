@@ -0,0 +1,84 @@
+/* ReaPack: Package manager for REAPER
+ * Copyright (C) 2015-2017  Christian Fillion
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef REAPACK_FILEBATCH_HPP
+#define REAPACK_FILEBATCH_HPP
+
+#include "filesystem.hpp"
+#include "path.hpp"
+#include "thread.hpp"
+
+#include <functional>
+#include <vector>
+
+// Applies the filesystem side of committed transaction tasks in a worker
+// thread. The batches are run one after the other by the serial worker, in
+// the order they were pushed, and so are the changes of every batch.
+class FileBatch : public ThreadTask {
+public:
+  struct Changes {
+    Changes() : recursive(false) {}
+
+    std::vector<TempPath> renames; // stops at the first failure
+    std::vector<Path> removals; // only after every file was renamed
+    bool recursive; // remove directories too
+  };
+
+  enum Status {
+    Committed,
+    Failed, // the temporary files were discarded
+    Cancelled, // nothing was done, the temporary files were discarded
+  };
+
+  struct Removal {
+    bool existed;
+    bool removed;
+    std::string error;
+  };
+
+  struct Result {
+    Status status;
+    ErrorInfo error; // of the failed rename
+    std::vector<FS::Stat> renamed; // size is -1 if the file cannot be found
+    std::vector<Removal> removals; // in the order of Changes::removals
+  };
+
+  // called in the main thread once the whole batch is done
+  typedef std::function<void (const Result &)> Callback;
+
+  FileBatch();
+
+  void add(const Changes &, const Callback &);
+  bool empty() const { return m_items.empty(); }
+
+  bool concurrent() const override { return false; }
+  void run(DownloadContext *) override;
+
+private:
+  struct Item {
+    Changes changes;
+    Callback callback;
+    Result result;
+  };
+
+  void apply(Item *);
+  void discard(Item *);
+
+  std::vector<Item> m_items;
+};
+
+#endif
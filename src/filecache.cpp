@@ -0,0 +1,202 @@
+/* ReaPack: Package manager for REAPER
+ * Copyright (C) 2015-2017  Christian Fillion
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "filecache.hpp"
+
+#include "errors.hpp"
+#include "filesystem.hpp"
+#include "hash.hpp"
+
+#include <ctime>
+#include <fstream>
+#include <vector>
+
+using namespace std;
+
+static bool HashFile(const Path &path, string *digest)
+{
+  ifstream stream;
+  return FS::open(stream, path) && Hash::file(stream, digest);
+}
+
+Path FileCache::pathFor(const string &hash)
+{
+  return Path::CACHE + "files" + hash;
+}
+
+FileCache::FileCache(const int64_t maxSize)
+  : m_db(Path::prefixRoot(Path::CACHE + "files.db").join()), m_maxSize(maxSize)
+{
+  FS::mkdir(Path::CACHE + "files");
+
+  migrate();
+
+  m_findUrl = m_db.prepare(
+    "SELECT hash FROM urls WHERE url = ? AND version = ? LIMIT 1");
+  m_insertUrl = m_db.prepare("INSERT OR REPLACE INTO urls VALUES(?, ?, ?)");
+  m_insertBlob = m_db.prepare("INSERT OR REPLACE INTO blobs VALUES(?, ?, ?)");
+  m_touchBlob = m_db.prepare("UPDATE blobs SET atime = ? WHERE hash = ?");
+  m_forgetUrls = m_db.prepare("DELETE FROM urls WHERE hash = ?");
+  m_forgetBlob = m_db.prepare("DELETE FROM blobs WHERE hash = ?");
+  m_totalSize = m_db.prepare("SELECT COALESCE(SUM(size), 0) FROM blobs");
+  m_oldestBlobs = m_db.prepare("SELECT hash, size FROM blobs ORDER BY atime");
+}
+
+void FileCache::migrate()
+{
+  const Database::Version version{0, 2};
+  const Database::Version &current = m_db.version();
+
+  if(!current) {
+    m_db.exec(
+      "CREATE TABLE urls ("
+      "  url TEXT NOT NULL,"
+      "  version TEXT NOT NULL,"
+      "  hash TEXT NOT NULL,"
+      "  PRIMARY KEY (url, version)"
+      ");"
+
+      "CREATE TABLE blobs ("
+      "  hash TEXT PRIMARY KEY,"
+      "  size INTEGER NOT NULL,"
+      "  atime INTEGER NOT NULL"
+      ");"
+    );
+
+    m_db.setVersion(version);
+    return;
+  }
+  else if(current < version) {
+    m_db.begin();
+
+    switch(current.minor) {
+    case 1:
+      // the files were looked up by URL only, the unused ones are evicted later
+      m_db.exec(
+        "DROP TABLE urls;"
+        "CREATE TABLE urls ("
+        "  url TEXT NOT NULL,"
+        "  version TEXT NOT NULL,"
+        "  hash TEXT NOT NULL,"
+        "  PRIMARY KEY (url, version)"
+        ");"
+      );
+    }
+
+    m_db.setVersion(version);
+    m_db.commit();
+  }
+  else if(version < current)
+    throw reapack_error("The download cache was created by a newer version of ReaPack");
+}
+
+bool FileCache::fetch(const string &url, const string &version, const Path &target)
+{
+  WDL_MutexLock lock(&m_mutex);
+
+  string hash;
+  m_findUrl->bind(1, url);
+  m_findUrl->bind(2, version);
+  m_findUrl->exec([&] {
+    hash = m_findUrl->stringColumn(0);
+    return false;
+  });
+
+  if(hash.empty())
+    return false;
+
+  const Path &blob = pathFor(hash);
+
+  // the file may have been modified through the hard link made by store()
+  string actualHash;
+  if(!HashFile(blob, &actualHash) || actualHash != hash) {
+    forget(hash);
+    return false;
+  }
+
+  FS::remove(target);
+
+  // not linked: the installed files must stay independent of the cache
+  if(!FS::copy(blob, target))
+    return false;
+
+  m_touchBlob->bind(1, time(nullptr));
+  m_touchBlob->bind(2, hash);
+  m_touchBlob->exec();
+
+  return true;
+}
+
+void FileCache::store(const string &url, const string &version,
+  const Path &file, const string &hash, const int64_t size)
+{
+  if(size > m_maxSize)
+    return;
+
+  WDL_MutexLock lock(&m_mutex);
+
+  const Path &blob = pathFor(hash);
+
+  if(!FS::exists(blob) && !FS::link(file, blob) && !FS::copy(file, blob))
+    return;
+
+  m_insertBlob->bind(1, hash);
+  m_insertBlob->bind(2, size);
+  m_insertBlob->bind(3, time(nullptr));
+  m_insertBlob->exec();
+
+  m_insertUrl->bind(1, url);
+  m_insertUrl->bind(2, version);
+  m_insertUrl->bind(3, hash);
+  m_insertUrl->exec();
+
+  evict();
+}
+
+void FileCache::forget(const string &hash)
+{
+  FS::remove(pathFor(hash));
+
+  m_forgetUrls->bind(1, hash);
+  m_forgetUrls->exec();
+
+  m_forgetBlob->bind(1, hash);
+  m_forgetBlob->exec();
+}
+
+void FileCache::evict()
+{
+  int64_t total = 0;
+  m_totalSize->exec([&] {
+    total = m_totalSize->intColumn(0);
+    return false;
+  });
+
+  if(total <= m_maxSize)
+    return;
+
+  // least recently used first
+  vector<string> victims;
+  m_oldestBlobs->exec([&] {
+    victims.push_back(m_oldestBlobs->stringColumn(0));
+    total -= m_oldestBlobs->intColumn(1);
+    return total > m_maxSize;
+  });
+
+  for(const string &hash : victims)
+    forget(hash);
+}
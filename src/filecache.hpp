@@ -0,0 +1,61 @@
+/* ReaPack: Package manager for REAPER
+ * Copyright (C) 2015-2017  Christian Fillion
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef REAPACK_FILECACHE_HPP
+#define REAPACK_FILECACHE_HPP
+
+#include "database.hpp"
+#include "path.hpp"
+
+#include <WDL/mutex.h>
+
+// Keeps a copy of downloaded package files under Path::CACHE.
+// Files are stored by content hash and looked up by URL and package version,
+// as many indexes link to the latest revision of a branch whose contents
+// change from one version to the next. Cached files are verified and copied
+// before being reused, so an installed file never shares the cached one.
+class FileCache {
+public:
+  FileCache(int64_t maxSize);
+
+  bool fetch(const std::string &url, const std::string &version, const Path &target);
+  // the hash and size of the file are computed by the caller
+  void store(const std::string &url, const std::string &version,
+    const Path &file, const std::string &hash, int64_t size);
+
+private:
+  static Path pathFor(const std::string &hash);
+
+  void migrate();
+  void forget(const std::string &hash);
+  void evict();
+
+  WDL_Mutex m_mutex;
+  Database m_db;
+  int64_t m_maxSize;
+
+  Statement *m_findUrl;
+  Statement *m_insertUrl;
+  Statement *m_insertBlob;
+  Statement *m_touchBlob;
+  Statement *m_forgetUrls;
+  Statement *m_forgetBlob;
+  Statement *m_totalSize;
+  Statement *m_oldestBlobs;
+};
+
+#endif
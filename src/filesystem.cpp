@@ -29,6 +29,10 @@
 
 #ifdef _WIN32
 #include <windows.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
 #endif
 
 using namespace std;
@@ -53,12 +57,13 @@ bool FS::open(ifstream &stream, const Path &path)
   return stream.good();
 }
 
-bool FS::open(ofstream &stream, const Path &path)
+bool FS::open(ofstream &stream, const Path &path, const bool append)
 {
   mkdir(path.dirname());
 
   const Path &fullPath = Path::prefixRoot(path);
-  stream.open(make_autostring(fullPath.join()), ios_base::binary);
+  stream.open(make_autostring(fullPath.join()),
+    append ? ios_base::binary | ios_base::app : ios_base::binary);
   return stream.good();
 }
 
@@ -80,7 +85,16 @@ bool FS::rename(const TempPath &path)
   remove(path.target());
 #endif
 
-  return rename(path.temp(), path.target());
+  if(!rename(path.temp(), path.target()))
+    return false;
+
+#ifndef _WIN32
+  // rename() does nothing if both paths are hard links to the same file
+  // (eg. when both were served by the download cache)
+  remove(path.temp());
+#endif
+
+  return true;
 }
 
 bool FS::rename(const Path &from, const Path &to)
@@ -96,6 +110,38 @@ bool FS::rename(const Path &from, const Path &to)
 #endif
 }
 
+bool FS::copy(const Path &from, const Path &to)
+{
+  ifstream input;
+  ofstream output;
+
+  if(!open(input, from) || !open(output, to))
+    return false;
+
+  // inserting an empty buffer would set the failbit
+  if(input.peek() != ifstream::traits_type::eof())
+    output << input.rdbuf();
+
+  output.close();
+
+  return output.good();
+}
+
+bool FS::link(const Path &from, const Path &to)
+{
+  mkdir(to.dirname());
+
+  const string &fullFrom = Path::prefixRoot(from).join();
+  const string &fullTo = Path::prefixRoot(to).join();
+
+#ifdef _WIN32
+  return CreateHardLink(make_autostring(fullTo).c_str(),
+    make_autostring(fullFrom).c_str(), nullptr) != 0;
+#else
+  return !::link(fullFrom.c_str(), fullTo.c_str());
+#endif
+}
+
 bool FS::remove(const Path &path)
 {
   const auto_string &fullPath =
@@ -163,6 +209,109 @@ bool FS::mtime(const Path &path, time_t *time)
   return true;
 }
 
+bool FS::size(const Path &path, int64_t *size)
+{
+  const Path &fullPath = Path::prefixRoot(path);
+
+#ifdef _WIN32
+  struct _stat64 st;
+
+  if(_wstat64(make_autostring(fullPath.join()).c_str(), &st))
+    return false;
+#else
+  struct stat st;
+
+  if(stat(fullPath.join().c_str(), &st))
+    return false;
+#endif
+
+  *size = st.st_size;
+
+  return true;
+}
+
+bool FS::stat(const Path &path, Stat *out)
+{
+  const Path &fullPath = Path::prefixRoot(path);
+
+#ifdef _WIN32
+  struct _stat64 st;
+
+  if(_wstat64(make_autostring(fullPath.join()).c_str(), &st))
+    return false;
+#else
+  struct stat st;
+
+  if(::stat(fullPath.join().c_str(), &st))
+    return false;
+#endif
+
+  out->size = st.st_size;
+  out->mtime = st.st_mtime;
+
+  return true;
+}
+
+bool FS::list(const Path &dir, map<string, Stat> *files)
+{
+  const Path &fullPath = Path::prefixRoot(dir);
+
+#ifdef _WIN32
+  WIN32_FIND_DATA data;
+  const HANDLE find = FindFirstFile(
+    make_autostring((fullPath + "*").join()).c_str(), &data);
+
+  if(find == INVALID_HANDLE_VALUE)
+    return false;
+
+  do {
+    if(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+      continue;
+
+    // from 100-nanosecond intervals since 1601 to seconds since 1970
+    const int64_t mtime = ((int64_t)data.ftLastWriteTime.dwHighDateTime << 32 |
+      data.ftLastWriteTime.dwLowDateTime) / 10000000 - 11644473600LL;
+
+    (*files)[from_autostring(data.cFileName)] = {
+      (int64_t)data.nFileSizeHigh << 32 | data.nFileSizeLow, (time_t)mtime};
+  } while(FindNextFile(find, &data));
+
+  FindClose(find);
+#else
+  DIR *handle = opendir(fullPath.join().c_str());
+
+  if(!handle)
+    return false;
+
+  while(const dirent *entry = readdir(handle)) {
+    Stat info{-1, 0};
+
+    switch(entry->d_type) {
+    case DT_REG:
+      break;
+    case DT_LNK:
+    case DT_UNKNOWN: {
+      // the type is not known without following the entry
+      struct stat st;
+      if(fstatat(dirfd(handle), entry->d_name, &st, 0) || !S_ISREG(st.st_mode))
+        continue;
+
+      info = {st.st_size, st.st_mtime};
+      break;
+    }
+    default:
+      continue;
+    }
+
+    (*files)[entry->d_name] = info;
+  }
+
+  closedir(handle);
+#endif
+
+  return true;
+}
+
 bool FS::exists(const Path &path)
 {
   const Path &fullPath = Path::prefixRoot(path);
@@ -179,3 +328,24 @@ string FS::lastError()
 {
   return strerror(errno);
 }
+
+bool FileSnapshot::find(const Path &path, FS::Stat *st)
+{
+  const Path &dir = path.dirname();
+  auto it = m_dirs.find(dir);
+
+  if(it == m_dirs.end()) {
+    // a missing directory is remembered as empty
+    it = m_dirs.emplace(dir, map<string, FS::Stat>{}).first;
+    FS::list(dir, &it->second);
+  }
+
+  const auto file = it->second.find(path.last());
+  if(file == it->second.end())
+    return false;
+
+  if(st)
+    *st = file->second;
+
+  return true;
+}
@@ -18,25 +18,52 @@
 #ifndef REAPACK_FILESYSTEM_HPP
 #define REAPACK_FILESYSTEM_HPP
 
-#include <string>
+#include "path.hpp"
 
-class Path;
-class TempPath;
+#include <cstdint>
+#include <ctime>
+#include <map>
+#include <string>
 
 namespace FS {
+  struct Stat {
+    int64_t size;
+    time_t mtime;
+
+    bool operator==(const Stat &o) const
+    { return size == o.size && mtime == o.mtime; }
+  };
+
   FILE *open(const Path &);
   bool open(std::ifstream &, const Path &);
-  bool open(std::ofstream &, const Path &);
+  bool open(std::ofstream &, const Path &, bool append = false);
   bool write(const Path &, const std::string &);
   bool rename(const TempPath &);
   bool rename(const Path &, const Path &);
+  bool copy(const Path &from, const Path &to);
+  bool link(const Path &from, const Path &to);
   bool remove(const Path &);
   bool removeRecursive(const Path &);
   bool mtime(const Path &, time_t *);
+  bool size(const Path &, int64_t *);
+  bool stat(const Path &, Stat *);
+  // the regular files of a directory, without a lookup for each
+  // (their size is -1 if the listing does not tell it, as on POSIX systems)
+  bool list(const Path &dir, std::map<std::string, Stat> *);
   bool exists(const Path &);
   void mkdir(const Path &);
 
   std::string lastError();
 };
 
+// Lists each directory once for looking up many files in it,
+// the files themselves are never stat'ed
+class FileSnapshot {
+public:
+  bool find(const Path &, FS::Stat * = nullptr);
+
+private:
+  std::map<Path, std::map<std::string, FS::Stat>> m_dirs;
+};
+
 #endif
@@ -0,0 +1,46 @@
+/* ReaPack: Package manager for REAPER
+ * Copyright (C) 2015-2017  Christian Fillion
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef REAPACK_HASH_HPP
+#define REAPACK_HASH_HPP
+
+#include <array>
+#include <cstdint>
+#include <istream>
+#include <string>
+
+// SHA-256 implementation used to identify file contents
+class Hash {
+public:
+  static bool file(std::istream &, std::string *digest, int64_t *size = nullptr);
+
+  Hash();
+
+  void addData(const char *data, size_t len);
+  void addData(const std::string &str) { addData(str.c_str(), str.size()); }
+  std::string digest();
+
+private:
+  void transform(const uint8_t *block);
+
+  std::array<uint32_t, 8> m_state;
+  std::array<uint8_t, 64> m_buffer;
+  size_t m_bufferSize;
+  uint64_t m_length;
+};
+
+#endif
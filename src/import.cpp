@@ -124,7 +124,7 @@ void Import::fetch()
     delete dl;
   });
 
-  dl->start();
+  m_reapack->threadPool()->push(dl);
 }
 
 void Import::read()
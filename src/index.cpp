@@ -85,17 +85,23 @@ IndexPtr Index::load(const string &name, const char *data)
 FileDownload *Index::fetch(const Remote &remote,
   const bool stale, const NetworkOpts &opts)
 {
+  const Path &path = pathFor(remote.name());
   time_t mtime = 0, now = time(nullptr);
 
-  if(FS::mtime(pathFor(remote.name()), &mtime)) {
+  if(FS::mtime(path, &mtime)) {
+    // a 304 response only touches the validators file
+    time_t checked;
+    if(FS::mtime(FileDownload::validatorsPathFor(path), &checked))
+      mtime = max(mtime, checked);
+
     const time_t threshold = stale ? 0 : (7 * 24 * 3600);
 
     if(mtime > now - threshold)
       return nullptr;
   }
 
-  const Path &path = pathFor(remote.name());
-  auto fd = new FileDownload(path, remote.url(), opts, Download::NoCacheFlag);
+  auto fd = new FileDownload(path, remote.url(), opts,
+    Download::NoCacheFlag | Download::ConditionalFlag);
   fd->setName(remote.name());
   return fd;
 }
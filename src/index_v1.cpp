@@ -19,6 +19,8 @@
 
 #include "errors.hpp"
 
+#include <algorithm>
+#include <cstdlib>
 #include <sstream>
 #include <WDL/tinyxml/tinyxml.h>
 
@@ -179,6 +181,9 @@ void LoadSourceV1(TiXmlElement *node, Version *ver)
   const char *main = node->Attribute("main");
   if(!main) main = "";
 
+  const char *size = node->Attribute("size");
+  if(!size) size = "0";
+
   const char *url = node->GetText();
   if(!url) url = "";
 
@@ -195,6 +200,9 @@ void LoadSourceV1(TiXmlElement *node, Version *ver)
     sections |= Source::getSection(section.c_str());
   src->setSections(sections);
 
+  // only used for scheduling the downloads, ignore garbage
+  src->setSize(max<int64_t>(0, strtoll(size, nullptr, 10)));
+
   if(ver->addSource(src))
     ptr.release();
 }
@@ -0,0 +1,209 @@
+/* ReaPack: Package manager for REAPER
+ * Copyright (C) 2015-2017  Christian Fillion
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "journal.hpp"
+
+#include "encoding.hpp"
+#include "filesystem.hpp"
+#include "hash.hpp"
+
+#include <sstream>
+
+#ifdef _WIN32
+#  include <windows.h>
+#else
+#  include <fcntl.h>
+#  include <sys/file.h>
+#  include <unistd.h>
+#endif
+
+using namespace std;
+
+static bool HashFile(const Path &path, string *digest)
+{
+  ifstream stream;
+  return FS::open(stream, path) && Hash::file(stream, digest);
+}
+
+static vector<string> Split(const string &line)
+{
+  vector<string> fields;
+  istringstream stream(line);
+
+  string field;
+  while(getline(stream, field, '\t'))
+    fields.push_back(field);
+
+  return fields;
+}
+
+Journal::Journal(const Path &path) : m_path(path)
+{
+  // another process is running its own transaction
+  m_owner = lock();
+  if(!m_owner)
+    return;
+
+  const bool truncated = read();
+
+  // keep the records of the interrupted transaction until this one is done
+  if(FS::open(m_stream, m_path, true) && truncated)
+    m_stream << '\n' << flush;
+}
+
+Journal::~Journal()
+{
+  m_stream.close();
+
+  // the lock file is kept: removing it would let another process
+  // lock a new one while a third still holds the old one
+#ifdef _WIN32
+  if(m_lock != INVALID_HANDLE_VALUE)
+    CloseHandle(m_lock);
+#else
+  if(m_lock != -1)
+    close(m_lock); // also releases the lock
+#endif
+}
+
+bool Journal::lock()
+{
+  const Path &lockPath =
+    Path::prefixRoot(m_path.dirname() + (m_path.last() + ".lock"));
+
+  // released by the system if the process dies
+#ifdef _WIN32
+  m_lock = CreateFile(make_autostring(lockPath.join()).c_str(), GENERIC_WRITE,
+    0, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+  return m_lock != INVALID_HANDLE_VALUE;
+#else
+  m_lock = open(lockPath.join().c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+
+  if(m_lock != -1 && flock(m_lock, LOCK_EX | LOCK_NB)) {
+    close(m_lock);
+    m_lock = -1;
+  }
+
+  return m_lock != -1;
+#endif
+}
+
+bool Journal::read()
+{
+  ifstream stream;
+  if(!FS::open(stream, m_path))
+    return false;
+
+  map<pair<string, string>, size_t> plans;
+  string line;
+
+  // every record is terminated by a newline, the last one may have been
+  // truncated if the process was killed in the middle of writing it
+  while(getline(stream, line) && !stream.eof()) {
+    const vector<string> &fields = Split(line);
+
+    if(fields.size() == 6 && (fields[0] == "install" || fields[0] == "uninstall")) {
+      const Plan plan{fields[0] == "install", fields[1], fields[2],
+        fields[3], fields[4], fields[5] == "1"};
+
+      // only the latest plan for a given package is kept
+      const auto key = make_pair(plan.remote + '\t' + plan.category, plan.package);
+      const auto it = plans.find(key);
+
+      if(it == plans.end()) {
+        plans[key] = m_interrupted.size();
+        m_interrupted.push_back(plan);
+      }
+      else
+        m_interrupted[it->second] = plan;
+    }
+    else if(fields.size() == 4 && fields[0] == "download")
+      m_downloads[{fields[1], fields[2]}] = fields[3];
+  }
+
+  return !line.empty();
+}
+
+void Journal::addPlan(const Plan &plan)
+{
+  append({plan.install ? "install" : "uninstall", plan.remote,
+    plan.category, plan.package, plan.version, plan.pin ? "1" : "0"});
+}
+
+void Journal::addDownload(const string &url, const TempPath &path,
+  const string &hash)
+{
+  {
+    WDL_MutexLock lock(&m_mutex);
+    m_downloads[{url, path.target().join()}] = hash;
+  }
+
+  append({"download", url, path.target().join(), hash});
+}
+
+bool Journal::fetch(const string &url, const TempPath &path)
+{
+  string hash;
+
+  {
+    WDL_MutexLock lock(&m_mutex);
+
+    const auto it = m_downloads.find({url, path.target().join()});
+    if(it == m_downloads.end())
+      return false;
+
+    hash = it->second;
+  }
+
+  string actualHash;
+  if(HashFile(path.temp(), &actualHash))
+    return actualHash == hash;
+
+  // the interrupted commit already moved the file into place: rename it again
+  // (not linked: renaming a file over another link to it does nothing)
+  return HashFile(path.target(), &actualHash) && actualHash == hash &&
+    FS::copy(path.target(), path.temp());
+}
+
+void Journal::append(const vector<string> &fields)
+{
+  WDL_MutexLock lock(&m_mutex);
+
+  if(!m_stream.is_open())
+    return;
+
+  for(size_t i = 0; i < fields.size(); i++)
+    m_stream << (i ? "\t" : "") << fields[i];
+
+  // survives the process being killed, not the system crashing
+  m_stream << '\n' << flush;
+}
+
+void Journal::finish()
+{
+  WDL_MutexLock lock(&m_mutex);
+
+  if(!m_owner)
+    return;
+
+  m_stream.close();
+  m_interrupted.clear();
+  m_downloads.clear();
+
+  FS::remove(m_path);
+}
@@ -0,0 +1,80 @@
+/* ReaPack: Package manager for REAPER
+ * Copyright (C) 2015-2017  Christian Fillion
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef REAPACK_JOURNAL_HPP
+#define REAPACK_JOURNAL_HPP
+
+#include "path.hpp"
+
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <WDL/mutex.h>
+
+// Write-ahead log of the running transaction, removed once it is finished.
+// When ReaPack is interrupted midway the next transaction reads it back
+// to resume the planned tasks without downloading the same files again.
+// Only one process at a time (REAPER or reapack-cli) may own the journal,
+// the others neither resume nor record anything.
+class Journal {
+public:
+  struct Plan {
+    bool install;
+    std::string remote;
+    std::string category;
+    std::string package;
+    std::string version; // empty for uninstallations
+    bool pin;
+  };
+
+  Journal(const Path &);
+  Journal(const Journal &) = delete;
+  ~Journal();
+
+  // the tasks of the interrupted transaction, in the order they were planned
+  const std::vector<Plan> &interrupted() const { return m_interrupted; }
+  void addPlan(const Plan &);
+
+  // safe to call from the worker threads
+  void addDownload(const std::string &url, const TempPath &, const std::string &hash);
+  bool fetch(const std::string &url, const TempPath &);
+
+  // forgets everything, the transaction has nothing left to resume
+  void finish();
+
+private:
+  bool lock();
+  bool read(); // true if the last record is incomplete
+  void append(const std::vector<std::string> &fields);
+
+  WDL_Mutex m_mutex;
+  Path m_path;
+  bool m_owner;
+#ifdef _WIN32
+  void *m_lock;
+#else
+  int m_lock;
+#endif
+  std::ofstream m_stream;
+  std::vector<Plan> m_interrupted;
+  // hash of the completed downloads, by URL and target path
+  std::map<std::pair<std::string, std::string>, std::string> m_downloads;
+};
+
+#endif
@@ -0,0 +1,233 @@
+/* ReaPack: Package manager for REAPER
+ * Copyright (C) 2015-2017  Christian Fillion
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "loopback.hpp"
+
+#include "filesystem.hpp"
+#include "path.hpp"
+#include "ratelimit.hpp"
+
+#include <fstream>
+#include <iterator>
+#include <sstream>
+
+using namespace std;
+
+static const size_t CHUNK_SIZE = 16384;
+
+static string EntityTag(const string &body)
+{
+  ostringstream stream;
+  stream << '"' << hex << hash<string>()(body) << '"';
+  return stream.str();
+}
+
+auto LoopbackTransport::Directory(const Path &root) -> Resolver
+{
+  return [=](const string &url, string *contents) {
+    const size_t scheme = url.find("://");
+    const size_t path = url.find('/', scheme == string::npos ? 0 : scheme + 3);
+
+    if(path == string::npos)
+      return false;
+
+    ifstream stream;
+    if(!FS::open(stream, root + url.substr(path + 1)))
+      return false;
+
+    contents->assign(istreambuf_iterator<char>(stream), istreambuf_iterator<char>());
+    return true;
+  };
+}
+
+LoopbackTransport::LoopbackTransport(const Options &opts, const Resolver &resolver)
+  : m_opts(opts), m_resolver(resolver), m_random(opts.seed), m_woken(false)
+{
+}
+
+void LoopbackTransport::add(Transfer *transfer)
+{
+  Stream stream{transfer};
+  stream.found = m_resolver(transfer->url, &stream.body);
+  stream.partial = false;
+  stream.begin = stream.sent = 0;
+  stream.end = stream.body.size();
+
+  string ifRange;
+  for(const string &header : transfer->headers) {
+    if(header.compare(0, 10, "If-Range: ") == 0)
+      ifRange = header.substr(10);
+  }
+
+  if(stream.found && !transfer->range.empty() &&
+      (ifRange.empty() || ifRange == EntityTag(stream.body))) {
+    const size_t dash = transfer->range.find('-');
+    stream.begin = min<size_t>(stoull(transfer->range), stream.end);
+
+    if(dash + 1 < transfer->range.size())
+      stream.end = min<size_t>(stoull(transfer->range.substr(dash + 1)) + 1, stream.end);
+
+    stream.partial = true;
+  }
+
+  stream.failAt = string::npos;
+  if(uniform_real_distribution<>()(m_random) < m_opts.errorRate) {
+    stream.failAt = uniform_int_distribution<size_t>(
+      0, stream.end - stream.begin)(m_random);
+  }
+
+  const auto latency = chrono::duration<double>(m_opts.latency);
+  stream.start = Clock::now() + chrono::duration_cast<Clock::duration>(latency);
+  stream.started = false;
+
+  m_streams.push_back(move(stream));
+}
+
+void LoopbackTransport::remove(Transfer *transfer)
+{
+  m_streams.remove_if([=](const Stream &s) { return s.transfer == transfer; });
+}
+
+void LoopbackTransport::respond(Stream &stream)
+{
+  Transfer *transfer = stream.transfer;
+
+  transfer->responseCode = !stream.found ? 404 : stream.partial ? 206 : 200;
+  transfer->effectiveUrl = transfer->url;
+  transfer->expected = stream.end - stream.begin;
+
+  if(!transfer->primary)
+    return;
+
+  ostringstream status;
+  status << "HTTP/1.1 " << transfer->responseCode;
+  readHeader(transfer, status.str());
+
+  if(!stream.found)
+    return;
+
+  readHeader(transfer, "Accept-Ranges: bytes");
+  readHeader(transfer, "ETag: " + EntityTag(stream.body));
+  readHeader(transfer, "Content-Length: " + to_string(stream.end - stream.begin));
+
+  if(stream.partial) {
+    ostringstream range;
+    range << "Content-Range: bytes " << stream.begin << '-'
+      << stream.end - 1 << '/' << stream.body.size();
+    readHeader(transfer, range.str());
+  }
+}
+
+void LoopbackTransport::perform()
+{
+  const auto now = Clock::now();
+  RateLimiter *limiter = RateLimiter::get();
+  vector<Transfer *> done;
+
+  for(auto it = m_streams.begin(); it != m_streams.end();) {
+    Stream &stream = *it;
+    Transfer *transfer = stream.transfer;
+
+    if(now < stream.start) {
+      it++;
+      continue;
+    }
+    else if(!stream.started) {
+      stream.started = true;
+      respond(stream);
+
+      if(!stream.found) {
+        transfer->error = "The requested URL returned error: 404";
+        done.push_back(transfer);
+        it = m_streams.erase(it);
+        continue;
+      }
+    }
+
+    const size_t size = stream.end - stream.begin;
+    size_t allowed = min(size, stream.failAt);
+
+    if(m_opts.bandwidth > 0) {
+      const chrono::duration<double> elapsed = now - stream.start;
+      allowed = min(allowed, (size_t)(elapsed.count() * m_opts.bandwidth));
+    }
+
+    bool ok = true;
+    while(ok && stream.sent < allowed && !limiter->delay()) {
+      const size_t chunk = min(CHUNK_SIZE, allowed - stream.sent);
+      ok = write(transfer, stream.body.data() + stream.begin + stream.sent, chunk);
+      stream.sent += chunk;
+      limiter->consume(chunk);
+    }
+
+    transfer->received = stream.sent;
+
+    if(!ok)
+      transfer->error = "Failed writing received data to disk/application";
+    else if(!progress(transfer, stream.sent, size))
+      transfer->error = "Operation was aborted by an application callback";
+    else if(stream.sent == stream.failAt)
+      transfer->error = "Simulated network failure";
+    else if(stream.sent < size) {
+      it++;
+      continue;
+    }
+
+    done.push_back(transfer);
+    it = m_streams.erase(it);
+  }
+
+  // may add new transfers (segments or a restart)
+  for(Transfer *transfer : done)
+    complete(transfer);
+}
+
+auto LoopbackTransport::nextEvent(const Stream &stream) const -> Clock::time_point
+{
+  if(!stream.started || m_opts.bandwidth <= 0)
+    return stream.start;
+
+  // when the next chunk is allowed to be sent
+  const double seconds = (stream.sent + CHUNK_SIZE) / m_opts.bandwidth;
+  return stream.start + chrono::duration_cast<Clock::duration>(
+    chrono::duration<double>(seconds));
+}
+
+void LoopbackTransport::poll(const int timeout)
+{
+  const auto now = Clock::now();
+  auto until = now + chrono::milliseconds(timeout);
+
+  // started streams cannot send anything until the rate limiter allows it
+  const auto throttled = now + chrono::milliseconds(RateLimiter::get()->delay());
+
+  for(const Stream &stream : m_streams) {
+    const auto next = nextEvent(stream);
+    until = min(until, stream.started ? max(next, throttled) : next);
+  }
+
+  unique_lock<mutex> lock(m_mutex);
+  m_wake.wait_until(lock, until, [this] { return m_woken; });
+  m_woken = false;
+}
+
+void LoopbackTransport::wakeup()
+{
+  lock_guard<mutex> guard(m_mutex);
+  m_woken = true;
+  m_wake.notify_one();
+}
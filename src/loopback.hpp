@@ -0,0 +1,83 @@
+/* ReaPack: Package manager for REAPER
+ * Copyright (C) 2015-2017  Christian Fillion
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef REAPACK_LOOPBACK_HPP
+#define REAPACK_LOOPBACK_HPP
+
+#include "transport.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <list>
+#include <mutex>
+#include <random>
+
+class Path;
+
+// Serves transfers from memory without any network access, with simulated
+// latency, bandwidth and failures. Used for offline tests and benchmarks.
+class LoopbackTransport : public Transport {
+public:
+  struct Options {
+    double latency; // seconds before the response starts
+    double bandwidth; // bytes per second for each transfer, 0 for unlimited
+    double errorRate; // probability of a transfer being cut midway
+    unsigned int seed;
+  };
+
+  // returns false if there is nothing at this URL
+  typedef std::function<bool (const std::string &url, std::string *)> Resolver;
+
+  // maps the path of the URLs to files in a local directory
+  static Resolver Directory(const Path &);
+
+  LoopbackTransport(const Options &, const Resolver &);
+
+  void add(Transfer *) override;
+  void remove(Transfer *) override;
+  void perform() override;
+  void poll(int timeout) override;
+  void wakeup() override;
+
+private:
+  typedef std::chrono::steady_clock Clock;
+
+  struct Stream {
+    Transfer *transfer;
+    std::string body;
+    bool found;
+    bool partial;
+    size_t begin, end, sent;
+    size_t failAt; // number of bytes sent before failing, npos if none
+    Clock::time_point start; // end of the simulated latency
+    bool started;
+  };
+
+  void respond(Stream &);
+  Clock::time_point nextEvent(const Stream &) const;
+
+  Options m_opts;
+  Resolver m_resolver;
+  std::mt19937 m_random;
+  std::list<Stream> m_streams;
+
+  std::mutex m_mutex;
+  std::condition_variable m_wake;
+  bool m_woken;
+};
+
+#endif
@@ -47,6 +47,7 @@ static bool loadAPI(void *(*getFunc)(const char *))
     REQUIRED_API(Splash_GetWnd),             // v4.7
 
     OPTIONAL_API(AddRemoveReaScript),        // v5.12
+    OPTIONAL_API(GetPlayState),
 
   };
 
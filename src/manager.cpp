@@ -500,7 +500,8 @@ void Manager::importArchive()
     return;
 
   try {
-    Archive::import(path, m_reapack);
+    Archive::import(path, m_reapack->config(),
+      bind(&ReaPack::setupTransaction, m_reapack));
   }
   catch(const reapack_error &e) {
     const auto_string &desc = make_autostring(e.what());
@@ -525,11 +526,11 @@ void Manager::exportArchive()
   if(path.empty())
     return;
 
-  ThreadPool *pool = new ThreadPool;
-  Dialog *progress = Dialog::Create<Progress>(instance(), parent(), pool);
+  TaskGroup *tasks = new TaskGroup(m_reapack->threadPool());
+  Dialog *progress = Dialog::Create<Progress>(instance(), parent(), tasks);
 
   try {
-    const size_t count = Archive::create(path, pool, m_reapack);
+    const size_t count = Archive::create(path, tasks, m_config);
 
     const auto finish = [=] {
       Dialog::Destroy(progress);
@@ -540,17 +541,17 @@ void Manager::exportArchive()
         count, count == 1 ? AUTO_STR("") : AUTO_STR("s"));
       MessageBox(handle(), msg, title, MB_OK);
 
-      delete pool;
+      delete tasks;
     };
 
-    pool->onDone(finish);
+    tasks->onDone(finish);
 
-    if(pool->idle())
+    if(tasks->idle())
       finish();
   }
   catch(const reapack_error &e) {
     Dialog::Destroy(progress);
-    delete pool;
+    delete tasks;
 
     const auto_string &desc = make_autostring(e.what());
 
@@ -609,8 +610,11 @@ void Manager::options()
 
 void Manager::setupNetwork()
 {
-  if(IDOK == Dialog::Show<NetworkConfig>(instance(), handle(), &m_config->network))
-    m_config->write();
+  if(IDOK != Dialog::Show<NetworkConfig>(instance(), handle(), &m_config->network))
+    return;
+
+  m_config->write();
+  m_reapack->applyNetworkOpts();
 }
 
 bool Manager::confirm() const
@@ -738,6 +742,21 @@ void NetworkConfig::onInit()
   m_verifyPeer = getControl(IDC_VERIFYPEER);
   SendMessage(m_verifyPeer, BM_SETCHECK,
     m_opts->verifyPeer ? BST_CHECKED : BST_UNCHECKED, 0);
+
+  m_lowPriority = getControl(IDC_LOWPRIO);
+  SendMessage(m_lowPriority, BM_SETCHECK,
+    m_opts->lowPriority ? BST_CHECKED : BST_UNCHECKED, 0);
+
+  m_reservedCpus = getControl(IDC_RESERVED);
+  SetWindowText(m_reservedCpus, make_autostring(m_opts->reservedCpus).c_str());
+
+  // 0 for unlimited
+  m_maxRate = getControl(IDC_MAXRATE);
+  SetWindowText(m_maxRate, make_autostring(to_string(m_opts->maxRate)).c_str());
+
+  m_playbackRate = getControl(IDC_PLAYRATE);
+  SetWindowText(m_playbackRate,
+    make_autostring(to_string(m_opts->playbackRate)).c_str());
 }
 
 void NetworkConfig::onCommand(const int id, int)
@@ -756,4 +775,8 @@ void NetworkConfig::apply()
 {
   m_opts->proxy = getText(m_proxy);
   m_opts->verifyPeer = SendMessage(m_verifyPeer, BM_GETCHECK, 0, 0) == BST_CHECKED;
+  m_opts->lowPriority = SendMessage(m_lowPriority, BM_GETCHECK, 0, 0) == BST_CHECKED;
+  m_opts->reservedCpus = getText(m_reservedCpus);
+  m_opts->maxRate = strtoul(getText(m_maxRate).c_str(), nullptr, 10);
+  m_opts->playbackRate = strtoul(getText(m_playbackRate).c_str(), nullptr, 10);
 }
@@ -113,6 +113,10 @@ private:
   NetworkOpts *m_opts;
   HWND m_proxy;
   HWND m_verifyPeer;
+  HWND m_lowPriority;
+  HWND m_reservedCpus;
+  HWND m_maxRate;
+  HWND m_playbackRate;
 };
 
 #endif
@@ -18,6 +18,7 @@
 #include "package.hpp"
 
 #include "errors.hpp"
+#include "hash.hpp"
 #include "index.hpp"
 
 #include <algorithm>
@@ -97,6 +98,32 @@ string Package::fullName() const
   return m_category ? m_category->fullName() + "/" + displayName() : displayName();
 }
 
+string Package::digest() const
+{
+  Hash hash;
+
+  // every field is terminated so that they can't be mistaken for one another
+  const auto add = [&] (const string &field) {
+    hash.addData(field.c_str(), field.size() + 1);
+  };
+
+  add(to_string(m_type));
+  add(m_name);
+
+  for(const Version *ver : m_versions) {
+    add(ver->name().toString());
+
+    for(const Source *src : ver->sources()) {
+      add(src->targetPath().join('/'));
+      add(src->url());
+      add(to_string(src->typeOverride()));
+      add(to_string(src->sections()));
+    }
+  }
+
+  return hash.digest();
+}
+
 bool Package::addVersion(const Version *ver)
 {
   if(ver->package() != this)
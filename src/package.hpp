@@ -63,6 +63,9 @@ public:
   const Version *lastVersion(bool pres = true, const VersionName &from = {}) const;
   const Version *findVersion(const VersionName &) const;
 
+  // changes whenever a version or a file is added, removed or modified
+  std::string digest() const;
+
 private:
   class CompareVersion {
   public:
@@ -235,8 +235,8 @@ UseRootPath::~UseRootPath()
   Path::s_root = move(m_backup);
 }
 
-TempPath::TempPath(const Path &target)
+TempPath::TempPath(const Path &target, const string &suffix)
   : m_target(target), m_temp(target)
 {
-  m_temp[m_temp.size() - 1] += ".part";
+  m_temp[m_temp.size() - 1] += suffix;
 }
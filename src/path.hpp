@@ -81,7 +81,7 @@ private:
 
 class TempPath {
 public:
-  TempPath(const Path &target);
+  TempPath(const Path &target, const std::string &suffix = ".part");
 
   const Path &target() const { return m_target; }
   const Path &temp() const { return m_temp; }
@@ -22,12 +22,34 @@
 
 using namespace std;
 
-Progress::Progress(ThreadPool *pool)
+enum Timers { TIMER_SHOW = 1, TIMER_UPDATE };
+
+static auto_string FormatSize(const double bytes)
+{
+  static const auto_char *UNITS[] =
+    {AUTO_STR("B"), AUTO_STR("KB"), AUTO_STR("MB"), AUTO_STR("GB")};
+
+  double size = bytes;
+  size_t unit = 0;
+
+  while(size >= 1024 && unit < (sizeof(UNITS) / sizeof(*UNITS)) - 1) {
+    size /= 1024;
+    unit++;
+  }
+
+  auto_char buf[32];
+  auto_snprintf(buf, auto_size(buf), unit ? AUTO_STR("%.1f %s") : AUTO_STR("%.0f %s"),
+    size, UNITS[unit]);
+
+  return buf;
+}
+
+Progress::Progress(TaskGroup *tasks)
   : Dialog(IDD_PROGRESS_DIALOG),
-    m_pool(pool), m_label(nullptr), m_progress(nullptr),
+    m_tasks(tasks), m_label(nullptr), m_transfer(nullptr), m_progress(nullptr),
     m_done(0), m_total(0)
 {
-  m_pool->onPush(bind(&Progress::addTask, this, placeholders::_1));
+  m_tasks->onPush(bind(&Progress::addTask, this, placeholders::_1));
 }
 
 void Progress::onInit()
@@ -35,16 +57,18 @@ void Progress::onInit()
   Dialog::onInit();
 
   m_label = getControl(IDC_LABEL);
+  m_transfer = getControl(IDC_LABEL2);
   m_progress = GetDlgItem(handle(), IDC_PROGRESS);
 
   SetWindowText(m_label, AUTO_STR("Initializing..."));
+  startTimer(500, TIMER_UPDATE);
 }
 
 void Progress::onCommand(const int id, int)
 {
   switch(id) {
   case IDCANCEL:
-    m_pool->abort();
+    m_tasks->abort();
 
     // don't wait until the current downloads are finished
     // before getting out of the user way
@@ -55,8 +79,16 @@ void Progress::onCommand(const int id, int)
 
 void Progress::onTimer(const int id)
 {
-  show();
-  stopTimer(id);
+  switch(id) {
+  case TIMER_SHOW:
+    show();
+    stopTimer(id);
+    break;
+  case TIMER_UPDATE:
+    if(m_total)
+      updateProgress();
+    break;
+  }
 }
 
 void Progress::addTask(ThreadTask *task)
@@ -65,7 +97,7 @@ void Progress::addTask(ThreadTask *task)
   updateProgress();
 
   if(!isVisible())
-    startTimer(100);
+    startTimer(100, TIMER_SHOW);
 
   task->onStart([=] {
     m_current = make_autostring(task->summary());
@@ -89,7 +121,20 @@ void Progress::updateProgress()
 
   SetWindowText(m_label, label);
 
-  const double pos = (double)(min(m_done+1, m_total)) / max(2, m_total);
+  const TaskGroup::Metrics &metrics = m_tasks->metrics();
+
+  double pos = (double)(min(m_done+1, m_total)) / max(2, m_total);
+
+  if(metrics.bytesTotal > 0) {
+    // assume the tasks of unknown size are as large as the others on average
+    const double average = (double)metrics.bytesTotal / metrics.sizedTasks;
+    const double expected = metrics.bytesTotal +
+      average * max(0, m_total - metrics.sizedTasks);
+
+    pos = min(1.0, metrics.bytesReceived / expected);
+    updateTransfer(metrics, expected);
+  }
+
   const int percent = (int)(pos * 100);
 
   auto_char title[255];
@@ -99,3 +144,24 @@ void Progress::updateProgress()
   SendMessage(m_progress, PBM_SETPOS, percent, 0);
   SetWindowText(handle(), title);
 }
+
+void Progress::updateTransfer(const TaskGroup::Metrics &metrics,
+  const double expected)
+{
+  auto_char text[255];
+
+  if(metrics.throughput > 0) {
+    const int remaining = (int)((expected - metrics.bytesReceived) / metrics.throughput);
+
+    auto_snprintf(text, auto_size(text), AUTO_STR("%s of %s at %s/s, %d:%02d remaining"),
+      FormatSize(metrics.bytesReceived).c_str(), FormatSize(expected).c_str(),
+      FormatSize(metrics.throughput).c_str(), max(0, remaining) / 60,
+      max(0, remaining) % 60);
+  }
+  else {
+    auto_snprintf(text, auto_size(text), AUTO_STR("%s of %s"),
+      FormatSize(metrics.bytesReceived).c_str(), FormatSize(expected).c_str());
+  }
+
+  SetWindowText(m_transfer, text);
+}
@@ -21,13 +21,12 @@
 #include "dialog.hpp"
 
 #include "encoding.hpp"
+#include "thread.hpp"
 
-class ThreadPool;
-class ThreadTask;
 
 class Progress : public Dialog {
 public:
-  Progress(ThreadPool *);
+  Progress(TaskGroup *);
 
 protected:
   void onInit() override;
@@ -37,11 +36,13 @@ protected:
 private:
   void addTask(ThreadTask *);
   void updateProgress();
+  void updateTransfer(const TaskGroup::Metrics &, double expected);
 
-  ThreadPool *m_pool;
+  TaskGroup *m_tasks;
   auto_string m_current;
 
   HWND m_label;
+  HWND m_transfer;
   HWND m_progress;
 
   int m_done;
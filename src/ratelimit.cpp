@@ -0,0 +1,123 @@
+/* ReaPack: Package manager for REAPER
+ * Copyright (C) 2015-2017  Christian Fillion
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ratelimit.hpp"
+
+#include <reaper_plugin_functions.h>
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+// the bucket holds at most this much of a second worth of data
+static const double BURST_TIME = 0.25;
+static const double MIN_BURST = 16384;
+
+static double Capacity(const int64_t rate)
+{
+  return max(rate * BURST_TIME, MIN_BURST);
+}
+
+RateLimiter *RateLimiter::get()
+{
+  static RateLimiter instance;
+  return &instance;
+}
+
+RateLimiter::RateLimiter()
+  : m_normalRate(0), m_playbackRate(0), m_playing(false), m_rate(0), m_tokens(0)
+{
+}
+
+void RateLimiter::setRates(const int64_t normal, const int64_t playback)
+{
+  m_normalRate = normal;
+  m_playbackRate = playback;
+  applyRate();
+}
+
+void RateLimiter::update()
+{
+  // the playback rate is ignored if the transport state is not available
+  if(!GetPlayState || (!m_playbackRate && !m_playing))
+    return;
+
+  // paused does not count as playing
+  const bool playing = (GetPlayState() & (1 | 4)) != 0;
+
+  if(playing != m_playing) {
+    m_playing = playing;
+    applyRate();
+  }
+}
+
+void RateLimiter::applyRate()
+{
+  int64_t rate = m_normalRate;
+
+  if(m_playing && m_playbackRate)
+    rate = rate ? min(rate, m_playbackRate) : m_playbackRate;
+
+  WDL_MutexLock lock(&m_mutex);
+
+  if(rate == m_rate)
+    return;
+  else if(m_rate > 0) {
+    // keep the debt of the data received at the previous rate
+    refill();
+    m_tokens = min(m_tokens, Capacity(rate));
+  }
+  else {
+    m_tokens = Capacity(rate);
+    m_lastRefill = Clock::now();
+  }
+
+  m_rate = rate;
+}
+
+void RateLimiter::refill()
+{
+  const Clock::time_point now = Clock::now();
+  const chrono::duration<double> elapsed = now - m_lastRefill;
+  m_lastRefill = now;
+
+  m_tokens = min(m_tokens + elapsed.count() * m_rate, Capacity(m_rate));
+}
+
+void RateLimiter::consume(const size_t bytes)
+{
+  if(!limited())
+    return;
+
+  WDL_MutexLock lock(&m_mutex);
+  m_tokens -= bytes;
+}
+
+int RateLimiter::delay()
+{
+  if(!limited())
+    return 0;
+
+  WDL_MutexLock lock(&m_mutex);
+  refill();
+
+  if(m_tokens > 0)
+    return 0;
+
+  return max(1, static_cast<int>(ceil(-m_tokens * 1000 / m_rate)));
+}
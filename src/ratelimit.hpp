@@ -0,0 +1,65 @@
+/* ReaPack: Package manager for REAPER
+ * Copyright (C) 2015-2017  Christian Fillion
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef REAPACK_RATELIMIT_HPP
+#define REAPACK_RATELIMIT_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include <WDL/mutex.h>
+
+// Token bucket shared by every transfer of the process, whichever worker
+// thread or transport carries it.
+class RateLimiter {
+public:
+  static RateLimiter *get();
+
+  // in bytes per second, 0 for no limit
+  void setRates(int64_t normal, int64_t playback);
+  // switches to the playback rate while REAPER's transport is playing or
+  // recording (REAPER API: to be called from the main thread only)
+  void update();
+
+  int64_t rate() const { return m_rate; }
+  bool limited() const { return m_rate > 0; }
+
+  void consume(size_t bytes);
+  // milliseconds to wait before receiving more data
+  int delay();
+
+private:
+  typedef std::chrono::steady_clock Clock;
+
+  RateLimiter();
+  void applyRate();
+  void refill();
+
+  // owned by the main thread
+  int64_t m_normalRate;
+  int64_t m_playbackRate;
+  bool m_playing;
+
+  std::atomic<int64_t> m_rate;
+
+  WDL_Mutex m_mutex;
+  double m_tokens; // in bytes, negative when overdrawn
+  Clock::time_point m_lastRefill;
+};
+
+#endif
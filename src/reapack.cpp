@@ -27,6 +27,7 @@
 #include "manager.hpp"
 #include "progress.hpp"
 #include "query.hpp"
+#include "ratelimit.hpp"
 #include "report.hpp"
 #include "richedit.hpp"
 #include "transaction.hpp"
@@ -35,7 +36,7 @@
 
 using namespace std;
 
-const char *ReaPack::VERSION = "1.2beta1";
+constexpr const char *ReaPack::VERSION;
 const char *ReaPack::BUILDTIME = __DATE__ " " __TIME__;
 
 #ifdef _WIN32
@@ -89,6 +90,9 @@ ReaPack::ReaPack(REAPER_PLUGIN_HINSTANCE instance)
   m_config = new Config;
   m_config->read(Path::prefixRoot(Path::CONFIG));
 
+  m_threadPool = new ThreadPool(m_config->install.workerThreads);
+  applyNetworkOpts();
+
   if(m_config->isFirstRun())
     manageRemotes();
 
@@ -103,6 +107,8 @@ ReaPack::~ReaPack()
 {
   Dialog::DestroyAll();
 
+  delete m_threadPool;
+
   m_config->write();
   delete m_config;
 
@@ -288,12 +294,12 @@ void ReaPack::fetchIndexes(const vector<Remote> &remotes,
   // (in `parent`) to the progress dialog prevents it from being shown at all
   // while still taking the focus away from the manager dialog.
 
-  ThreadPool *pool = new ThreadPool;
-  Dialog *progress = Dialog::Create<Progress>(m_instance, m_mainWindow, pool);
+  TaskGroup *tasks = new TaskGroup(m_threadPool);
+  Dialog *progress = Dialog::Create<Progress>(m_instance, m_mainWindow, tasks);
 
   auto load = [=] {
     Dialog::Destroy(progress);
-    delete pool;
+    delete tasks;
 
     vector<IndexPtr> indexes;
 
@@ -310,16 +316,16 @@ void ReaPack::fetchIndexes(const vector<Remote> &remotes,
     callback(indexes);
   };
 
-  pool->onDone(load);
+  tasks->onDone(load);
 
   for(const Remote &remote : remotes)
-    doFetchIndex(remote, pool, parent, stale);
+    doFetchIndex(remote, tasks, parent, stale);
 
-  if(pool->idle())
+  if(tasks->idle())
     load();
 }
 
-void ReaPack::doFetchIndex(const Remote &remote, ThreadPool *pool,
+void ReaPack::doFetchIndex(const Remote &remote, TaskGroup *tasks,
   HWND parent, const bool stale)
 {
   FileDownload *dl = Index::fetch(remote, stale, m_config->network);
@@ -350,7 +356,7 @@ void ReaPack::doFetchIndex(const Remote &remote, ThreadPool *pool,
       warn(dl->error().message, AUTO_STR("Download Failed"));
   });
 
-  pool->push(dl);
+  tasks->push(dl);
 }
 
 IndexPtr ReaPack::loadIndex(const Remote &remote, HWND parent)
@@ -387,7 +393,7 @@ Transaction *ReaPack::setupTransaction()
     return m_tx;
 
   try {
-    m_tx = new Transaction(m_config);
+    m_tx = new Transaction(m_config, m_threadPool);
   }
   catch(const reapack_error &e) {
     const auto_string &desc = make_autostring(e.what());
@@ -403,7 +409,7 @@ Transaction *ReaPack::setupTransaction()
   }
 
   assert(!m_progress);
-  m_progress = Dialog::Create<Progress>(m_instance, m_mainWindow, m_tx->threadPool());
+  m_progress = Dialog::Create<Progress>(m_instance, m_mainWindow, m_tx->tasks());
 
   m_tx->onFinish([=] {
     Dialog::Destroy(m_progress);
@@ -429,6 +435,9 @@ Transaction *ReaPack::setupTransaction()
 
   m_tx->setCleanupHandler(bind(&ReaPack::teardownTransaction, this));
 
+  // continue where the last transaction was interrupted
+  m_tx->resume();
+
   return m_tx;
 }
 
@@ -453,6 +462,15 @@ void ReaPack::refreshBrowser()
     m_browser->refresh();
 }
 
+void ReaPack::applyNetworkOpts()
+{
+  const NetworkOpts &opts = m_config->network;
+
+  m_threadPool->setScheduling(opts.lowPriority, opts.reservedCpus);
+  RateLimiter::get()->setRates(
+    int64_t(opts.maxRate) * 1024, int64_t(opts.playbackRate) * 1024);
+}
+
 void ReaPack::registerSelf()
 {
   // hard-coding galore!
@@ -35,6 +35,7 @@ class Index;
 class Manager;
 class Progress;
 class Remote;
+class TaskGroup;
 class ThreadPool;
 class Transaction;
 
@@ -46,7 +47,7 @@ public:
   typedef std::function<void (const IndexPtr &)> IndexCallback;
   typedef std::function<void (const std::vector<IndexPtr> &)> IndexesCallback;
 
-  static const char *VERSION;
+  static constexpr const char *VERSION = "1.2beta1";
   static const char *BUILDTIME;
 
   gaccel_register_t syncAction;
@@ -76,6 +77,8 @@ public:
   Browser *browsePackages();
   void refreshManager();
   void refreshBrowser();
+  // scheduling of the workers and bandwidth limits
+  void applyNetworkOpts();
 
   Remote remote(const std::string &name) const;
 
@@ -86,16 +89,18 @@ public:
 
   Transaction *setupTransaction();
   Config *config() const { return m_config; }
+  ThreadPool *threadPool() const { return m_threadPool; }
 
 private:
   void registerSelf();
-  void doFetchIndex(const Remote &remote, ThreadPool *, HWND, bool stale);
+  void doFetchIndex(const Remote &remote, TaskGroup *, HWND, bool stale);
   IndexPtr loadIndex(const Remote &remote, HWND);
   void teardownTransaction();
 
   std::map<int, ActionCallback> m_actions;
 
   Config *m_config;
+  ThreadPool *m_threadPool;
   Transaction *m_tx;
   Progress *m_progress;
   Browser *m_browser;
@@ -58,9 +58,20 @@ Registry::Registry(const Path &path)
 
   // file queries
   m_getFiles = m_db.prepare(
-    "SELECT path, main, type FROM files WHERE entry = ? ORDER BY path"
+    "SELECT path, main, type, size, mtime FROM files WHERE entry = ? ORDER BY path"
+  );
+  m_getRemoteFiles = m_db.prepare(
+    "SELECT files.path, files.main, files.type, files.size, files.mtime, "
+    "  entries.type "
+    "FROM files JOIN entries ON files.entry = entries.id "
+    "WHERE entries.remote = ?"
+  );
+  m_insertFile = m_db.prepare(
+    "INSERT INTO files(entry, path, main, type) VALUES(?, ?, ?, ?)"
+  );
+  m_setFingerprint = m_db.prepare(
+    "UPDATE files SET size = ?, mtime = ? WHERE path = ?"
   );
-  m_insertFile = m_db.prepare("INSERT INTO files VALUES(NULL, ?, ?, ?, ?)");
   m_clearFiles = m_db.prepare(
     "DELETE FROM files WHERE entry = ("
     "  SELECT id FROM entries WHERE remote = ? AND category = ? AND package = ?"
@@ -68,13 +79,29 @@ Registry::Registry(const Path &path)
   );
   m_forgetFiles = m_db.prepare("DELETE FROM files WHERE entry = ?");
 
+  // synchronization queries
+  m_getDigests = m_db.prepare(
+    "SELECT category, package, digest FROM synced WHERE remote = ?"
+  );
+  m_setDigest = m_db.prepare("INSERT OR REPLACE INTO synced VALUES(?, ?, ?, ?)");
+  m_forgetDigest = m_db.prepare(
+    "DELETE FROM synced WHERE remote = ? AND category = ? AND package = ?"
+  );
+  m_getIndexDigest = m_db.prepare(
+    "SELECT digest, verified FROM synced_indexes WHERE remote = ? LIMIT 1"
+  );
+  m_setIndexDigest = m_db.prepare(
+    "INSERT OR REPLACE INTO synced_indexes VALUES(?, ?, ?)"
+  );
+  m_forgetIndexDigest = m_db.prepare("DELETE FROM synced_indexes WHERE remote = ?");
+
   // lock the database
   m_db.begin();
 }
 
 void Registry::migrate()
 {
-  const Database::Version version{0, 5};
+  const Database::Version version{0, 9};
   const Database::Version &current = m_db.version();
 
   if(!current) {
@@ -99,8 +126,24 @@ void Registry::migrate()
       "  path TEXT UNIQUE NOT NULL,"
       "  main INTEGER NOT NULL,"
       "  type INTEGER NOT NULL,"
+      "  size INTEGER NOT NULL DEFAULT -1,"
+      "  mtime INTEGER NOT NULL DEFAULT 0,"
       "  FOREIGN KEY(entry) REFERENCES entries(id)"
       ");"
+
+      "CREATE TABLE synced ("
+      "  remote TEXT NOT NULL,"
+      "  category TEXT NOT NULL,"
+      "  package TEXT NOT NULL,"
+      "  digest TEXT NOT NULL,"
+      "  PRIMARY KEY(remote, category, package)"
+      ");"
+
+      "CREATE TABLE synced_indexes ("
+      "  remote TEXT PRIMARY KEY,"
+      "  digest TEXT NOT NULL,"
+      "  verified INTEGER NOT NULL DEFAULT 0"
+      ");"
     );
 
     m_db.setVersion(version);
@@ -128,6 +171,32 @@ void Registry::migrate()
       m_db.exec("ALTER TABLE entries ADD COLUMN desc TEXT NOT NULL DEFAULT '';");
     case 4:
       convertImplicitSections();
+    case 5:
+      m_db.exec(
+        "ALTER TABLE files ADD COLUMN size INTEGER NOT NULL DEFAULT -1;"
+        "ALTER TABLE files ADD COLUMN mtime INTEGER NOT NULL DEFAULT 0;"
+      );
+    case 6:
+      m_db.exec(
+        "CREATE TABLE synced ("
+        "  remote TEXT NOT NULL,"
+        "  category TEXT NOT NULL,"
+        "  package TEXT NOT NULL,"
+        "  digest TEXT NOT NULL,"
+        "  PRIMARY KEY(remote, category, package)"
+        ");"
+      );
+    case 7:
+      m_db.exec(
+        "CREATE TABLE synced_indexes ("
+        "  remote TEXT PRIMARY KEY,"
+        "  digest TEXT NOT NULL"
+        ");"
+      );
+    case 8:
+      m_db.exec(
+        "ALTER TABLE synced_indexes ADD COLUMN verified INTEGER NOT NULL DEFAULT 0;"
+      );
     }
 
     m_db.setVersion(version);
@@ -150,6 +219,8 @@ auto Registry::push(const Version *ver, vector<Path> *conflicts) -> Entry
   m_clearFiles->bind(3, pkg->name());
   m_clearFiles->exec();
 
+  forgetDigest(ri->name(), cat->name(), pkg->name());
+
   auto entryId = getEntry(ver->package()).id;
 
   // register or update package and version
@@ -209,11 +280,84 @@ auto Registry::push(const Version *ver, vector<Path> *conflicts) -> Entry
   }
 }
 
+void Registry::setFingerprint(const Path &path, const FS::Stat &st)
+{
+  m_setFingerprint->bind(1, st.size);
+  m_setFingerprint->bind(2, (int64_t)st.mtime);
+  m_setFingerprint->bind(3, path.join('/'));
+  m_setFingerprint->exec();
+}
+
 void Registry::setPinned(const Entry &entry, const bool pinned)
 {
   m_setPinned->bind(1, pinned);
   m_setPinned->bind(2, entry.id);
   m_setPinned->exec();
+
+  forgetDigest(entry.remote, entry.category, entry.package);
+}
+
+auto Registry::getDigests(const string &remoteName) const -> Digests
+{
+  Digests digests;
+
+  m_getDigests->bind(1, remoteName);
+  m_getDigests->exec([&] {
+    const auto key = make_pair(m_getDigests->stringColumn(0),
+      m_getDigests->stringColumn(1));
+    digests[key] = m_getDigests->stringColumn(2);
+    return true;
+  });
+
+  return digests;
+}
+
+void Registry::setDigest(const Package *pkg, const string &digest)
+{
+  const Category *cat = pkg->category();
+
+  m_setDigest->bind(1, cat->index()->name());
+  m_setDigest->bind(2, cat->name());
+  m_setDigest->bind(3, pkg->name());
+  m_setDigest->bind(4, digest);
+  m_setDigest->exec();
+}
+
+void Registry::forgetDigest(const string &remote,
+  const string &cat, const string &pkg)
+{
+  m_forgetDigest->bind(1, remote);
+  m_forgetDigest->bind(2, cat);
+  m_forgetDigest->bind(3, pkg);
+  m_forgetDigest->exec();
+
+  // the index must be looked at again to find that package
+  m_forgetIndexDigest->bind(1, remote);
+  m_forgetIndexDigest->exec();
+}
+
+string Registry::getIndexDigest(const string &remote, time_t *verified) const
+{
+  string digest;
+  *verified = 0;
+
+  m_getIndexDigest->bind(1, remote);
+  m_getIndexDigest->exec([&] {
+    digest = m_getIndexDigest->stringColumn(0);
+    *verified = static_cast<time_t>(m_getIndexDigest->intColumn(1));
+    return false;
+  });
+
+  return digest;
+}
+
+void Registry::setIndexDigest(const string &remote,
+  const string &digest, const time_t verified)
+{
+  m_setIndexDigest->bind(1, remote);
+  m_setIndexDigest->bind(2, digest);
+  m_setIndexDigest->bind(3, (int64_t)verified);
+  m_setIndexDigest->exec();
 }
 
 auto Registry::getEntry(const Package *pkg) const -> Entry
@@ -260,13 +404,26 @@ auto Registry::getFiles(const Entry &entry) const -> vector<File>
 
   m_getFiles->bind(1, entry.id);
   m_getFiles->exec([&] {
-    File file{m_getFiles->stringColumn(0)};
-    file.sections = static_cast<int>(m_getFiles->intColumn(1));
-    file.type = static_cast<Package::Type>(m_getFiles->intColumn(2));
+    File file{};
+    fillFile(m_getFiles, entry.type, &file);
+    files.push_back(file);
+    return true;
+  });
+
+  return files;
+}
+
+auto Registry::getRemoteFiles(const string &remoteName) const -> vector<File>
+{
+  vector<File> files;
 
-    if(!file.type) // < v1.0rc2
-      file.type = entry.type;
+  m_getRemoteFiles->bind(1, remoteName);
+  m_getRemoteFiles->exec([&] {
+    const auto entryType =
+      static_cast<Package::Type>(m_getRemoteFiles->intColumn(5));
 
+    File file{};
+    fillFile(m_getRemoteFiles, entryType, &file);
     files.push_back(file);
     return true;
   });
@@ -295,6 +452,8 @@ void Registry::forget(const Entry &entry)
 
   m_forgetEntry->bind(1, entry.id);
   m_forgetEntry->exec();
+
+  forgetDigest(entry.remote, entry.category, entry.package);
 }
 
 void Registry::savepoint()
@@ -359,3 +518,18 @@ void Registry::fillEntry(const Statement *stmt, Entry *entry) const
   entry->author = stmt->stringColumn(col++);
   entry->pinned = stmt->boolColumn(col++);
 }
+
+void Registry::fillFile(const Statement *stmt,
+  const Package::Type entryType, File *file) const
+{
+  int col = 0;
+
+  file->path = stmt->stringColumn(col++);
+  file->sections = static_cast<int>(stmt->intColumn(col++));
+  file->type = static_cast<Package::Type>(stmt->intColumn(col++));
+  file->fingerprint.size = stmt->intColumn(col++);
+  file->fingerprint.mtime = static_cast<time_t>(stmt->intColumn(col++));
+
+  if(!file->type) // < v1.0rc2
+    file->type = entryType;
+}
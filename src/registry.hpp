@@ -18,10 +18,12 @@
 #ifndef REAPACK_REGISTRY_HPP
 #define REAPACK_REGISTRY_HPP
 
+#include <map>
 #include <set>
 #include <string>
 
 #include "database.hpp"
+#include "filesystem.hpp"
 #include "package.hpp"
 #include "path.hpp"
 #include "version.hpp"
@@ -47,18 +49,36 @@ public:
     Path path;
     int sections;
     Package::Type type;
+    FS::Stat fingerprint; // size is -1 if unknown
 
     bool operator<(const File &o) const { return path < o.path; }
   };
 
+  // last synchronized digest of the packages of a repository
+  typedef std::map<std::pair<std::string, std::string>, std::string> Digests;
+
   Registry(const Path &path = {});
 
   Entry getEntry(const Package *) const;
   std::vector<Entry> getEntries(const std::string &) const;
   std::vector<File> getFiles(const Entry &) const;
   std::vector<File> getMainFiles(const Entry &) const;
+  // the files of every package installed from a repository at once
+  std::vector<File> getRemoteFiles(const std::string &remote) const;
   Entry push(const Version *, std::vector<Path> *conflicts = nullptr);
   void setPinned(const Entry &, bool pinned);
+  // remembers the state of an installed file
+  void setFingerprint(const Path &, const FS::Stat &);
+  // packages keep their digest until they are installed, pinned or removed
+  Digests getDigests(const std::string &remote) const;
+  void setDigest(const Package *, const std::string &digest);
+  void forgetDigest(const std::string &remote,
+    const std::string &cat, const std::string &pkg);
+  // the whole index, kept until any of its packages changes in the registry,
+  // with the last time every installed file of the repository was found
+  std::string getIndexDigest(const std::string &remote, time_t *verified) const;
+  void setIndexDigest(const std::string &remote,
+    const std::string &digest, time_t verified);
   void forget(const Entry &);
   void savepoint();
   void restore();
@@ -69,6 +89,7 @@ private:
   void migrate();
   void convertImplicitSections();
   void fillEntry(const Statement *, Entry *) const;
+  void fillFile(const Statement *, Package::Type, File *) const;
 
   Database m_db;
   Statement *m_insertEntry;
@@ -79,7 +100,16 @@ private:
   Statement *m_forgetEntry;
 
   Statement *m_getFiles;
+  Statement *m_getRemoteFiles;
   Statement *m_insertFile;
+  Statement *m_setFingerprint;
+
+  Statement *m_getDigests;
+  Statement *m_setDigest;
+  Statement *m_forgetDigest;
+  Statement *m_getIndexDigest;
+  Statement *m_setIndexDigest;
+  Statement *m_forgetIndexDigest;
   Statement *m_clearFiles;
   Statement *m_forgetFiles;
 
@@ -46,6 +46,8 @@
 #define IDC_LABEL      200
 #define IDC_LABEL2     201
 #define IDC_LABEL3     202
+#define IDC_LABEL4     203
+#define IDC_LABEL5     204
 #define IDC_PROGRESS   210
 #define IDC_REPORT     211
 #define IDC_LIST       212
@@ -70,5 +72,9 @@
 #define IDC_SCREENSHOT 231
 #define IDC_ENABLE     232
 #define IDC_CHANGELOG  233
+#define IDC_LOWPRIO    234
+#define IDC_RESERVED   235
+#define IDC_MAXRATE    236
+#define IDC_PLAYRATE   237
 
 #endif
@@ -51,7 +51,7 @@ auto Source::detectSection(const string &category) -> Section
 
 Source::Source(const string &file, const string &url, const Version *ver)
   : m_type(Package::UnknownType), m_file(file), m_url(url), m_sections(0),
-    m_version(ver)
+    m_size(0), m_version(ver)
 {
   if(m_url.empty())
     throw reapack_error("empty source url");
@@ -22,6 +22,8 @@
 #include "path.hpp"
 #include "platform.hpp"
 
+#include <cstdint>
+
 class Package;
 class Version;
 
@@ -50,6 +52,9 @@ public:
   const std::string &url() const { return m_url; }
   void setSections(int);
   int sections() const { return m_sections; }
+  // in bytes, 0 if the index doesn't tell
+  void setSize(int64_t size) { m_size = size; }
+  int64_t size() const { return m_size; }
 
   Path targetPath() const;
 
@@ -59,6 +64,7 @@ private:
   std::string m_file;
   std::string m_url;
   int m_sections;
+  int64_t m_size;
   Path m_targetPath;
   const Version *m_version;
 };
@@ -23,6 +23,7 @@
 #include "errors.hpp"
 #include "filesystem.hpp"
 #include "index.hpp"
+#include "journal.hpp"
 #include "transaction.hpp"
 
 using namespace std;
@@ -62,6 +63,14 @@ bool InstallTask::start()
     return false;
   }
 
+  const Package *pkg = m_version->package();
+  tx()->journal()->addPlan({true, pkg->category()->index()->name(),
+    pkg->category()->name(), pkg->name(), m_version->name().toString(), m_pin});
+
+  // the same URL may serve different contents for another version
+  const string &cacheVersion = pkg->category()->index()->name() + '/' +
+    pkg->category()->name() + '/' + pkg->name() + ' ' + m_version->name().toString();
+
   for(const Source *src : m_version->sources()) {
     const Path &targetPath = src->targetPath();
 
@@ -73,19 +82,34 @@ bool InstallTask::start()
 
     if(m_reader) {
       FileExtractor *ex = new FileExtractor(targetPath, m_reader);
-      push(ex, ex->path());
+      watch(ex, ex->path());
+      tx()->tasks()->push(ex);
     }
     else {
       const NetworkOpts &opts = tx()->config()->network;
-      FileDownload *dl = new FileDownload(targetPath, src->url(), opts);
-      push(dl, dl->path());
+      // large binaries are worth the extra requests of a segmented download
+      const Package::Type type = src->type();
+      const int flags = type == Package::ExtensionType ||
+        type == Package::ThemeType ? Download::SegmentedFlag : 0;
+
+      FileDownload *dl = new FileDownload(targetPath, src->url(), opts, flags);
+      dl->setCache(tx()->fileCache(), cacheVersion);
+      dl->setJournal(tx()->journal());
+      if(src->size())
+        dl->setExpectedSize(src->size());
+
+      // a duplicate of a download in progress is pushed by the transaction
+      const bool first = tx()->download(dl);
+      watch(dl, dl->path());
+      if(first)
+        tx()->tasks()->push(dl);
     }
   }
 
   return true;
 }
 
-void InstallTask::push(ThreadTask *job, const TempPath &path)
+void InstallTask::watch(ThreadTask *job, const TempPath &path)
 {
   job->onStart([=] { m_newFiles.push_back(path); });
   job->onFinish([=] {
@@ -93,31 +117,49 @@ void InstallTask::push(ThreadTask *job, const TempPath &path)
 
     if(job->state() != ThreadTask::Success)
       rollback();
+
+    // may delete this task
+    if(m_waiting.empty())
+      tx()->taskReady(this);
   });
 
   m_waiting.insert(job);
-  tx()->threadPool()->push(job);
 }
 
-void InstallTask::commit()
+FileBatch::Changes InstallTask::changes() const
 {
+  FileBatch::Changes changes;
+
   if(m_fail)
-    return;
+    return changes;
 
-  for(const TempPath &paths : m_newFiles) {
-    if(!FS::rename(paths)) {
-      tx()->receipt()->addError({"Cannot rename to target: " + FS::lastError(),
-        paths.target().join()});
+  changes.renames = m_newFiles;
 
-      // it's a bit late to rollback here as some files might already have been
-      // overwritten. at least we can delete the temporary files
-      rollback();
-      return;
+  for(const Registry::File &file : m_oldFiles)
+    changes.removals.push_back(file.path);
+
+  return changes;
+}
+
+void InstallTask::commit(const FileBatch::Result &result)
+{
+  if(m_fail)
+    return;
+  else if(result.status != FileBatch::Committed) {
+    if(result.status == FileBatch::Failed) {
+      tx()->receipt()->addError({"Cannot rename to target: " +
+        result.error.message, result.error.context});
     }
+
+    // the temporary files were already deleted
+    m_fail = true;
+    return;
   }
 
-  for(const Registry::File &file : m_oldFiles) {
-    if(FS::remove(file.path))
+  for(size_t i = 0; i < m_oldFiles.size(); i++) {
+    const Registry::File &file = m_oldFiles[i];
+
+    if(result.removals[i].removed)
       tx()->receipt()->addRemoval(file.path);
 
     tx()->registerFile({false, m_oldEntry, file});
@@ -140,13 +182,19 @@ void InstallTask::commit()
   if(m_pin)
     tx()->registry()->setPinned(newEntry, true);
 
+  // allows the next synchronizations to quickly tell the files are unchanged
+  for(size_t i = 0; i < m_newFiles.size(); i++) {
+    if(result.renamed[i].size >= 0)
+      tx()->registry()->setFingerprint(m_newFiles[i].target(), result.renamed[i]);
+  }
+
   tx()->registerAll(true, newEntry);
 }
 
 void InstallTask::rollback()
 {
   for(const TempPath &paths : m_newFiles)
-    FS::removeRecursive(paths.temp());
+    FileDownload::discard(paths);
 
   for(ThreadTask *job : m_waiting)
     job->abort();
@@ -154,6 +202,35 @@ void InstallTask::rollback()
   m_fail = true;
 }
 
+void InstallTask::claim()
+{
+  if(m_fail)
+    return;
+
+  // the conflicts were already reported by start()
+  vector<Path> conflicts;
+
+  try {
+    tx()->registry()->push(m_version, &conflicts);
+  }
+  catch(const reapack_error &) {}
+}
+
+vector<Path> InstallTask::releasedFiles() const
+{
+  vector<Path> paths;
+
+  for(const Registry::File &file : m_oldFiles)
+    paths.push_back(file.path);
+
+  return paths;
+}
+
+set<Path> InstallTask::takenFiles() const
+{
+  return m_version->files();
+}
+
 UninstallTask::UninstallTask(const Registry::Entry &re, Transaction *tx)
   : Task(tx), m_entry(move(re))
 {
@@ -163,22 +240,42 @@ bool UninstallTask::start()
 {
   tx()->registry()->getFiles(m_entry).swap(m_files);
 
+  tx()->journal()->addPlan({false, m_entry.remote,
+    m_entry.category, m_entry.package, {}, false});
+
   // allow conflicting packages to be installed
   tx()->registry()->forget(m_entry);
 
   return true;
 }
 
-void UninstallTask::commit()
+FileBatch::Changes UninstallTask::changes() const
 {
-  for(const auto &file : m_files) {
-    if(!FS::exists(file.path))
+  FileBatch::Changes changes;
+  changes.recursive = true;
+
+  for(const auto &file : m_files)
+    changes.removals.push_back(file.path);
+
+  return changes;
+}
+
+void UninstallTask::commit(const FileBatch::Result &result)
+{
+  if(result.status != FileBatch::Committed)
+    return;
+
+  for(size_t i = 0; i < m_files.size(); i++) {
+    const Registry::File &file = m_files[i];
+    const FileBatch::Removal &removal = result.removals[i];
+
+    if(!removal.existed)
       continue;
 
-    if(FS::removeRecursive(file.path))
+    if(removal.removed)
       tx()->receipt()->addRemoval(file.path);
     else
-      tx()->receipt()->addError({FS::lastError(), file.path.join()});
+      tx()->receipt()->addError({removal.error, file.path.join()});
 
     tx()->registerFile({false, m_entry, file});
   }
@@ -191,7 +288,7 @@ PinTask::PinTask(const Registry::Entry &re, const bool pin, Transaction *tx)
 {
 }
 
-void PinTask::commit()
+void PinTask::commit(const FileBatch::Result &)
 {
   tx()->registry()->setPinned(m_entry, m_pin);
 }
@@ -18,6 +18,7 @@
 #ifndef REAPACK_TASK_HPP
 #define REAPACK_TASK_HPP
 
+#include "filebatch.hpp"
 #include "path.hpp"
 #include "registry.hpp"
 
@@ -41,8 +42,18 @@ public:
   virtual ~Task() {}
 
   virtual bool start() { return true; }
-  virtual void commit() = 0;
+  // commit() or rollback() is called as soon as this returns true
+  virtual bool ready() const { return true; }
+  // applied in a worker thread, then commit() is called in the main thread
+  virtual FileBatch::Changes changes() const { return {}; }
+  virtual void commit(const FileBatch::Result &) = 0;
   virtual void rollback() {}
+  // pushes the new files again for detecting conflicts with tasks started later
+  virtual void claim() {}
+
+  // tasks taking over files from another one are committed after it
+  virtual std::vector<Path> releasedFiles() const { return {}; }
+  virtual std::set<Path> takenFiles() const { return {}; }
 
   bool operator<(const Task &o) { return priority() < o.priority(); }
 
@@ -60,11 +71,16 @@ public:
     const ArchiveReaderPtr &, Transaction *);
 
   bool start() override;
-  void commit() override;
+  bool ready() const override { return m_waiting.empty(); }
+  FileBatch::Changes changes() const override;
+  void commit(const FileBatch::Result &) override;
   void rollback() override;
+  void claim() override;
+  std::vector<Path> releasedFiles() const override;
+  std::set<Path> takenFiles() const override;
 
 private:
-  void push(ThreadTask *, const TempPath &);
+  void watch(ThreadTask *, const TempPath &);
 
   const Version *m_version;
   bool m_pin;
@@ -85,12 +101,12 @@ public:
 protected:
   int priority() const override { return 1; }
   bool start() override;
-  void commit() override;
+  FileBatch::Changes changes() const override;
+  void commit(const FileBatch::Result &) override;
 
 private:
   Registry::Entry m_entry;
   std::vector<Registry::File> m_files;
-  std::set<Path> m_removedFiles;
 };
 
 class PinTask : public Task {
@@ -98,7 +114,7 @@ public:
   PinTask(const Registry::Entry &, bool pin, Transaction *);
 
 protected:
-  void commit() override;
+  void commit(const FileBatch::Result &) override;
 
 private:
   Registry::Entry m_entry;
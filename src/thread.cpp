@@ -18,22 +18,38 @@
 #include "thread.hpp"
 
 #include "download.hpp"
+#include "ratelimit.hpp"
 
 #include <reaper_plugin_functions.h>
 
+#include <cstdio>
+#include <sstream>
+#include <thread>
+
+#ifdef __APPLE__
+#  include <sys/resource.h>
+#elif !defined(_WIN32)
+#  include <sched.h>
+#  include <sys/resource.h>
+#  include <sys/syscall.h>
+#  include <unistd.h>
+#endif
+
 using namespace std;
 
 ThreadNotifier *ThreadNotifier::s_instance = nullptr;
 
+// about every quarter of a second at REAPER's timer rate
+static const size_t RATE_UPDATE_TICKS = 8;
+
 ThreadTask::ThreadTask()
-  : m_state(Idle), m_abort(false)
+  : m_state(Idle), m_abort(false), m_bytesReceived(0), m_bytesTotal(0),
+    m_timeToFirstByte(0), m_totalTime(0)
 {
-  ThreadNotifier::get()->start();
 }
 
 ThreadTask::~ThreadTask()
 {
-  ThreadNotifier::get()->stop();
 }
 
 void ThreadTask::setState(const State state)
@@ -55,6 +71,24 @@ void ThreadTask::setState(const State state)
   }
 }
 
+double ThreadTask::throughput() const
+{
+  const double time = m_totalTime - m_timeToFirstByte;
+  return time > 0 ? m_bytesReceived / time : 0;
+}
+
+void ThreadTask::setBytes(const int64_t received, const int64_t total)
+{
+  m_bytesReceived = received;
+  m_bytesTotal = total;
+}
+
+void ThreadTask::setTimes(const double firstByte, const double total)
+{
+  m_timeToFirstByte = firstByte;
+  m_totalTime = total;
+}
+
 void ThreadTask::finish(const State state, const ErrorInfo &error)
 {
   m_error = error;
@@ -62,35 +96,59 @@ void ThreadTask::finish(const State state, const ErrorInfo &error)
   ThreadNotifier::get()->notify({this, state});
 };
 
-WorkerThread::WorkerThread() : m_exit(false)
+WorkerThread::WorkerThread(const bool network,
+    const Scheduling *scheduling, const Group *group)
+  : m_thread(nullptr), m_exit(false), m_scheduling(scheduling),
+    m_schedulingVersion(0), m_group(group)
 {
-  m_wake = CreateEvent(nullptr, true, false, AUTO_STR("WakeEvent"));
-  m_thread = CreateThread(nullptr, 0, run, (void *)this, 0, nullptr);
+  if(network)
+    m_context = make_unique<DownloadContext>();
+
+  m_wake = CreateEvent(nullptr, true, false, nullptr);
 }
 
 WorkerThread::~WorkerThread()
 {
+  stop();
+
+  CloseHandle(m_wake);
+}
+
+void WorkerThread::stop()
+{
+  if(!m_thread)
+    return;
+
   m_exit = true;
   SetEvent(m_wake);
 
+  if(m_context)
+    m_context->wakeup();
+
   WaitForSingleObject(m_thread, INFINITE);
 
-  CloseHandle(m_wake);
   CloseHandle(m_thread);
+  m_thread = nullptr;
 }
 
 DWORD WINAPI WorkerThread::run(void *ptr)
 {
   WorkerThread *thread = static_cast<WorkerThread *>(ptr);
+  DownloadContext *context = thread->m_context.get();
 
-  DownloadContext context;
+  // keep going until the aborted transfers are finished when exiting
+  while(!thread->m_exit || (context && !context->idle())) {
+    thread->applyScheduling();
 
-  while(!thread->m_exit) {
     while(ThreadTask *task = thread->nextTask())
-      task->run(&context);
-
-    ResetEvent(thread->m_wake);
-    WaitForSingleObject(thread->m_wake, INFINITE);
+      task->run(context);
+
+    if(context && !context->idle())
+      context->perform(); // returns early when woken up by push()
+    else if(!thread->m_exit) {
+      WaitForSingleObject(thread->m_wake, INFINITE);
+      ResetEvent(thread->m_wake);
+    }
   }
 
   return 0;
@@ -98,60 +156,293 @@ DWORD WINAPI WorkerThread::run(void *ptr)
 
 ThreadTask *WorkerThread::nextTask()
 {
-  WDL_MutexLock lock(&m_mutex);
+  {
+    WDL_MutexLock lock(&m_mutex);
+
+    if(!m_queue.empty()) {
+      ThreadTask *task = m_queue.front();
+      m_queue.pop_front();
+      return task;
+    }
+  }
 
-  if(m_queue.empty())
+  return steal();
+}
+
+ThreadTask *WorkerThread::steal()
+{
+  if(!m_group)
     return nullptr;
 
-  ThreadTask *task = m_queue.front();
-  m_queue.pop();
-  return task;
+  // take the last task of another worker, which is most likely
+  // stuck behind a slow one
+  for(const auto &worker : *m_group) {
+    if(worker.get() == this)
+      continue;
+
+    WDL_MutexLock lock(&worker->m_mutex);
+
+    if(!worker->m_queue.empty()) {
+      ThreadTask *task = worker->m_queue.back();
+      worker->m_queue.pop_back();
+      return task;
+    }
+  }
+
+  return nullptr;
+}
+
+void WorkerThread::applyScheduling()
+{
+  const unsigned int version = m_scheduling->version;
+  if(version == m_schedulingVersion)
+    return;
+
+  m_schedulingVersion = version;
+  const bool background = m_scheduling->background;
+  const uint64_t avoidCpus = m_scheduling->avoidCpus;
+
+#ifdef _WIN32
+  // also lowers the I/O and memory priorities of the thread
+  SetThreadPriority(GetCurrentThread(),
+    background ? THREAD_MODE_BACKGROUND_BEGIN : THREAD_MODE_BACKGROUND_END);
+
+  DWORD_PTR process, system;
+  if(GetProcessAffinityMask(GetCurrentProcess(), &process, &system)) {
+    const DWORD_PTR allowed = process & ~static_cast<DWORD_PTR>(avoidCpus);
+    SetThreadAffinityMask(GetCurrentThread(), allowed ? allowed : process);
+  }
+#elif defined(__APPLE__)
+  // throttles both CPU and I/O, macOS has no way to set the CPU affinity
+  (void)avoidCpus;
+  setpriority(PRIO_DARWIN_THREAD, 0, background ? PRIO_DARWIN_BG : 0);
+#else
+  const pid_t tid = static_cast<pid_t>(syscall(SYS_gettid));
+
+  // going back to normal priority is not allowed without privileges
+  setpriority(PRIO_PROCESS, tid, background ? 19 : 0);
+
+  // idle I/O class, or the default one (IOPRIO_WHO_PROCESS is 1)
+  const int ioprio = background ? 3 << 13 : 0;
+  syscall(SYS_ioprio_set, 1, tid, ioprio);
+
+  cpu_set_t cpus;
+  if(!sched_getaffinity(getpid(), sizeof(cpus), &cpus)) {
+    for(int i = 0; i < 64; i++) {
+      if(avoidCpus >> i & 1)
+        CPU_CLR(i, &cpus);
+    }
+
+    if(CPU_COUNT(&cpus))
+      sched_setaffinity(0, sizeof(cpus), &cpus);
+  }
+#endif
 }
 
 void WorkerThread::push(ThreadTask *task)
 {
   WDL_MutexLock lock(&m_mutex);
 
-  m_queue.push(task);
+  m_queue.push_back(task);
   SetEvent(m_wake);
+
+  if(m_context)
+    m_context->wakeup();
+
+  if(!m_thread)
+    m_thread = CreateThread(nullptr, 0, run, (void *)this, 0, nullptr);
+}
+
+ThreadPool::ThreadPool(const unsigned int workers)
+  : m_size(workers), m_next(0)
+{
+  if(!m_size)
+    m_size = max(1u, thread::hardware_concurrency());
 }
 
 ThreadPool::~ThreadPool()
 {
-  // don't emit ThreadPool::onAbort from the destructor
+  // the workers wait for the aborted transfers before exiting
+  for(const auto &pair : m_running) {
+    ThreadTask *task = pair.first;
+    pair.second.disconnect();
+    task->onFinish([] { ThreadNotifier::get()->stop(); });
+    task->abort();
+  }
+
+  // the downloads may hand their last step over to the other workers
+  if(m_concurrent)
+    m_concurrent->stop();
+
+  // stop all workers before destroying any of them, they may be stealing
+  // from one another until then
+  for(const auto &worker : m_workers)
+    worker->stop();
+}
+
+void ThreadPool::push(ThreadTask *task)
+{
+  // deliver notifications to the main thread only while tasks are running
+  ThreadNotifier::get()->start();
+
+  m_running[task] = task->onFinish([=] {
+    m_running.erase(task);
+    ThreadNotifier::get()->stop();
+  });
+
+  if(task->concurrent()) {
+    if(!m_concurrent) {
+      // finished downloads are hashed by the parallel workers
+      startWorkers();
+
+      m_concurrent = make_unique<WorkerThread>(true, &m_scheduling);
+      m_concurrent->context()->setDispatcher(
+        [=](ThreadTask *task) { pushParallel(task); });
+    }
+
+    m_concurrent->push(task);
+  }
+  else if(task->parallel()) {
+    startWorkers();
+    pushParallel(task);
+  }
+  else {
+    if(!m_serial)
+      m_serial = make_unique<WorkerThread>(false, &m_scheduling);
+
+    m_serial->push(task);
+  }
+}
+
+void ThreadPool::startWorkers()
+{
+  // the group must be complete before any worker starts stealing
+  while(m_workers.size() < m_size) {
+    m_workers.push_back(
+      make_unique<WorkerThread>(false, &m_scheduling, &m_workers));
+  }
+}
+
+void ThreadPool::pushParallel(ThreadTask *task)
+{
+  m_workers[m_next++ % m_size]->push(task);
+}
+
+void ThreadPool::setScheduling(const bool background, const string &reservedCpus)
+{
+  m_scheduling.background = background;
+  m_scheduling.avoidCpus = CpuMask(reservedCpus);
+  m_scheduling.version++;
+}
+
+uint64_t ThreadPool::CpuMask(const string &list)
+{
+  uint64_t mask = 0;
+
+  istringstream stream(list);
+  string range;
+
+  while(getline(stream, range, ',')) {
+    unsigned int first, last;
+
+    switch(sscanf(range.c_str(), "%u-%u", &first, &last)) {
+    case 1:
+      last = first;
+      break;
+    case 2:
+      break;
+    default:
+      continue;
+    }
+
+    for(unsigned int i = first; i <= last && i < 64; i++)
+      mask |= uint64_t(1) << i;
+  }
+
+  return mask;
+}
+
+TaskGroup::TaskGroup(ThreadPool *pool)
+  : m_pool(pool), m_bytesReceived(0), m_bytesTotal(0), m_sizedTasks(0),
+    m_busyTime(0)
+{
+}
+
+TaskGroup::~TaskGroup()
+{
+  // don't emit TaskGroup::onAbort from the destructor
   // which is most likely to cause a crash
   m_onAbort.disconnect_all_slots();
 
   abort();
+
+  // the aborted tasks finish after the group is gone
+  for(const auto &pair : m_running)
+    pair.second.disconnect();
 }
 
-void ThreadPool::push(ThreadTask *task)
+void TaskGroup::push(ThreadTask *task)
 {
   m_onPush(task);
-  m_running.insert(task);
 
-  task->onFinish([=] {
+  if(m_running.empty())
+    m_busySince = chrono::steady_clock::now();
+
+  m_running[task] = task->onFinish([=] {
     m_running.erase(task);
 
-    // call m_onDone() only after every onFinish slots ran
-    if(m_running.empty())
+    m_bytesReceived += task->bytesReceived();
+
+    // tasks without any data don't make the average size smaller
+    if(const int64_t total = max(task->bytesTotal(), task->bytesReceived())) {
+      m_bytesTotal += total;
+      m_sizedTasks++;
+    }
+
+    if(m_running.empty()) {
+      const chrono::duration<double> busy = chrono::steady_clock::now() - m_busySince;
+      m_busyTime += busy.count();
+
+      // call m_onDone() only after every onFinish slots ran
       m_onDone();
+    }
   });
 
   task->setCleanupHandler([=] { delete task; });
 
-  const size_t nextThread = m_running.size() % m_pool.size();
-  auto &thread = task->concurrent() ? m_pool[nextThread] : m_pool.front();
-  if(!thread)
-    thread = make_unique<WorkerThread>();
+  m_pool->push(task);
+}
+
+auto TaskGroup::metrics() const -> Metrics
+{
+  Metrics metrics{m_bytesReceived, m_bytesTotal, m_sizedTasks, 0};
+  double busyTime = m_busyTime;
+
+  for(const auto &pair : m_running) {
+    const ThreadTask *task = pair.first;
+    metrics.bytesReceived += task->bytesReceived();
+
+    if(const int64_t total = task->bytesTotal()) {
+      metrics.bytesTotal += total;
+      metrics.sizedTasks++;
+    }
+  }
 
-  thread->push(task);
+  if(!m_running.empty()) {
+    const chrono::duration<double> busy = chrono::steady_clock::now() - m_busySince;
+    busyTime += busy.count();
+  }
+
+  if(busyTime > 0)
+    metrics.throughput = metrics.bytesReceived / busyTime;
+
+  return metrics;
 }
 
-void ThreadPool::abort()
+void TaskGroup::abort()
 {
-  for(ThreadTask *task : m_running)
-    task->abort();
+  for(const auto &pair : m_running)
+    pair.first->abort();
 
   m_onAbort();
 }
@@ -164,6 +455,12 @@ ThreadNotifier *ThreadNotifier::get()
   return s_instance;
 }
 
+ThreadNotifier::ThreadNotifier()
+  : m_active(0), m_head(nullptr), m_depth(0), m_maxDepth(0), m_delivered(0),
+    m_totalLatency(0), m_maxLatency(0), m_ticks(0), m_idleTicks(0)
+{
+}
+
 void ThreadNotifier::start()
 {
   if(!m_active++)
@@ -177,17 +474,34 @@ void ThreadNotifier::stop()
 
 void ThreadNotifier::notify(const Notification &notif)
 {
-  WDL_MutexLock lock(&m_mutex);
+  Node *node = new Node{notif, Clock::now(), m_head.load()};
 
-  m_queue.push(notif);
+  // never blocks on the main thread, even while it is delivering
+  while(!m_head.compare_exchange_weak(node->next, node));
+
+  m_depth++;
 }
 
 void ThreadNotifier::tick()
 {
   ThreadNotifier *instance = ThreadNotifier::get();
-  instance->processQueue();
 
-  // doing this in stop() would cause a use after free of m_mutex in processQueue
+  // the transport state can only be queried from the main thread,
+  // there is no need to do it as often as notifications are delivered
+  if(!(++instance->m_ticks % RATE_UPDATE_TICKS))
+    RateLimiter::get()->update();
+
+  // nothing to do in most ticks, don't touch anything the workers write to
+  if(!instance->m_head.load(memory_order_relaxed)) {
+    instance->m_idleTicks++;
+
+    if(instance->m_active)
+      return;
+  }
+  else
+    instance->processQueue();
+
+  // doing this in stop() would cause a use after free in processQueue
   if(!instance->m_active) {
     plugin_register("-timer", (void *)tick);
 
@@ -198,11 +512,38 @@ void ThreadNotifier::tick()
 
 void ThreadNotifier::processQueue()
 {
-  WDL_MutexLock lock(&m_mutex);
-
-  while(!m_queue.empty()) {
-    const Notification &notif = m_queue.front();
-    notif.first->setState(notif.second);
-    m_queue.pop();
+  // slots may queue more notifications, deliver these in the same tick
+  while(Node *node = m_head.exchange(nullptr)) {
+    m_maxDepth = max<size_t>(m_maxDepth, m_depth);
+
+    // the stack is newest first, deliver in the order they were sent
+    Node *list = nullptr;
+    while(node) {
+      Node *next = node->next;
+      node->next = list;
+      list = node;
+      node = next;
+    }
+
+    while(list) {
+      Node *next = list->next;
+      m_depth--;
+
+      const chrono::duration<double> latency = Clock::now() - list->time;
+      m_totalLatency += latency.count();
+      m_maxLatency = max(m_maxLatency, latency.count());
+      m_delivered++;
+
+      list->notif.first->setState(list->notif.second);
+      delete list;
+      list = next;
+    }
   }
 }
+
+auto ThreadNotifier::stats() const -> Stats
+{
+  return {m_depth, m_maxDepth, m_delivered,
+    m_delivered ? m_totalLatency / m_delivered : 0, m_maxLatency,
+    m_ticks, m_idleTicks};
+}
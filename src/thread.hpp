@@ -18,13 +18,18 @@
 #ifndef REAPACK_THREAD_HPP
 #define REAPACK_THREAD_HPP
 
+#include "callback.hpp"
 #include "errors.hpp"
 
-#include <array>
 #include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
 #include <functional>
-#include <queue>
-#include <unordered_set>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 #include <boost/signals2.hpp>
 #include <WDL/mutex.h>
@@ -35,7 +40,7 @@
 #include <swell-types.h>
 #endif
 
-struct DownloadContext;
+class DownloadContext;
 
 class ThreadTask {
 public:
@@ -47,13 +52,16 @@ public:
     Aborted,
   };
 
-  typedef boost::signals2::signal<void ()> VoidSignal;
+  // emitted in the main thread only, for every task
+  typedef Signal<void ()> VoidSignal;
   typedef std::function<void ()> CleanupHandler;
 
   ThreadTask();
   virtual ~ThreadTask();
 
   virtual bool concurrent() const = 0;
+  // non-concurrent tasks that may run alongside each other on any worker
+  virtual bool parallel() const { return false; }
   virtual void run(DownloadContext *) = 0;
 
   const std::string &summary() const { return m_summary; }
@@ -62,15 +70,26 @@ public:
   const ErrorInfo &error() { return m_error; }
 
   void onStart(const VoidSignal::slot_type &slot) { m_onStart.connect(slot); }
-  void onFinish(const VoidSignal::slot_type &slot) { m_onFinish.connect(slot); }
+  VoidSignal::Connection onFinish(const VoidSignal::slot_type &slot)
+  { return m_onFinish.connect(slot); }
   void setCleanupHandler(const CleanupHandler &cb) { m_cleanupHandler = cb; }
 
   bool aborted() const { return m_abort; }
-  void abort() { m_abort = true; }
+  // tasks blocking on something else than the CPU should also interrupt it
+  virtual void abort() { m_abort = true; }
+
+  // transfer metrics, updated from the worker thread
+  int64_t bytesReceived() const { return m_bytesReceived; }
+  int64_t bytesTotal() const { return m_bytesTotal; } // 0 if unknown
+  double timeToFirstByte() const { return m_timeToFirstByte; } // in seconds
+  double totalTime() const { return m_totalTime; }
+  double throughput() const; // in bytes per second
 
 protected:
   void setSummary(const std::string &s) { m_summary = s; }
   void finish(State, const ErrorInfo & = {});
+  void setBytes(int64_t received, int64_t total);
+  void setTimes(double firstByte, double total);
 
 private:
   std::string m_summary;
@@ -78,6 +97,11 @@ private:
   ErrorInfo m_error;
   std::atomic_bool m_abort;
 
+  std::atomic<int64_t> m_bytesReceived;
+  std::atomic<int64_t> m_bytesTotal;
+  std::atomic<double> m_timeToFirstByte;
+  std::atomic<double> m_totalTime;
+
   VoidSignal m_onStart;
   VoidSignal m_onFinish;
   CleanupHandler m_cleanupHandler;
@@ -85,44 +109,114 @@ private:
 
 class WorkerThread {
 public:
-  WorkerThread();
+  typedef std::vector<std::unique_ptr<WorkerThread>> Group;
+
+  // keeps the workers out of the way of REAPER's real-time audio threads
+  struct Scheduling {
+    Scheduling() : background(false), avoidCpus(0), version(0) {}
+
+    std::atomic_bool background; // lowest CPU and I/O priority
+    std::atomic<uint64_t> avoidCpus; // bitmask of the CPU cores not to use
+    std::atomic<unsigned int> version; // bumped after every change
+  };
+
+  // idle workers steal tasks from the other workers of their group
+  WorkerThread(bool network, const Scheduling *, const Group *group = nullptr);
   ~WorkerThread();
 
   void push(ThreadTask *);
-  void clear();
+  void stop();
+
+  DownloadContext *context() const { return m_context.get(); }
 
 private:
   static DWORD WINAPI run(void *);
   ThreadTask *nextTask();
+  ThreadTask *steal();
+  void applyScheduling();
 
   HANDLE m_wake;
-  HANDLE m_thread;
+  HANDLE m_thread; // started by the first push
   std::atomic_bool m_exit;
   WDL_Mutex m_mutex;
-  std::queue<ThreadTask *> m_queue;
+  std::deque<ThreadTask *> m_queue;
+  std::unique_ptr<DownloadContext> m_context;
+  const Scheduling *m_scheduling;
+  unsigned int m_schedulingVersion;
+  const Group *m_group;
 };
 
+// Long-lived workers shared by every operation, so that the download
+// contexts (and their open connections) are reused from one to the next
 class ThreadPool {
 public:
-  typedef boost::signals2::signal<void ()> VoidSignal;
-  typedef boost::signals2::signal<void (ThreadTask *)> TaskSignal;
-
-  ThreadPool() {}
+  ThreadPool(unsigned int workers = 0); // 0 for one per CPU core
   ThreadPool(const ThreadPool &) = delete;
   ~ThreadPool();
 
+  void push(ThreadTask *);
+
+  // applies to the running workers before their next task
+  void setScheduling(bool background, const std::string &reservedCpus);
+  static uint64_t CpuMask(const std::string &list); // eg. "0,2-3"
+
+private:
+  void startWorkers();
+  void pushParallel(ThreadTask *); // from any thread once the workers exist
+
+  // must outlive the workers
+  WorkerThread::Scheduling m_scheduling;
+
+  // concurrent tasks (downloads) share the event loop of a single thread,
+  // parallel tasks are spread over the workers and the other ones are run
+  // one after the other in a separate thread
+  std::unique_ptr<WorkerThread> m_concurrent;
+  std::unique_ptr<WorkerThread> m_serial;
+  WorkerThread::Group m_workers;
+  unsigned int m_size;
+  std::atomic<size_t> m_next;
+  std::unordered_map<ThreadTask *, ThreadTask::VoidSignal::Connection> m_running;
+};
+
+// The tasks of a single operation running in the shared ThreadPool
+class TaskGroup {
+public:
+  // onDone may destroy the group, which boost::signals2 allows
+  typedef boost::signals2::signal<void ()> VoidSignal;
+  typedef Signal<void (ThreadTask *)> TaskSignal;
+
+  TaskGroup(ThreadPool *);
+  TaskGroup(const TaskGroup &) = delete;
+  ~TaskGroup();
+
   void push(ThreadTask *);
   void abort();
 
   bool idle() const { return m_running.empty(); }
 
+  struct Metrics {
+    int64_t bytesReceived;
+    int64_t bytesTotal;
+    int sizedTasks; // tasks included in bytesTotal
+    double throughput; // in bytes per second while the group was busy
+  };
+
+  Metrics metrics() const;
+
   void onPush(const TaskSignal::slot_type &slot) { m_onPush.connect(slot); }
   void onAbort(const VoidSignal::slot_type &slot) { m_onAbort.connect(slot); }
   void onDone(const VoidSignal::slot_type &slot) { m_onDone.connect(slot); }
 
 private:
-  std::array<std::unique_ptr<WorkerThread>, 3> m_pool;
-  std::unordered_set<ThreadTask *> m_running;
+  ThreadPool *m_pool;
+  std::unordered_map<ThreadTask *, ThreadTask::VoidSignal::Connection> m_running;
+
+  // metrics of the tasks that already finished
+  int64_t m_bytesReceived;
+  int64_t m_bytesTotal;
+  int m_sizedTasks;
+  double m_busyTime;
+  std::chrono::steady_clock::time_point m_busySince;
 
   TaskSignal m_onPush;
   VoidSignal m_onAbort;
@@ -130,7 +224,8 @@ private:
 };
 
 // This singleton class receives state change notifications from a
-// worker thread and applies them in the main thread
+// worker thread and applies them in the main thread. Its timer is only
+// registered while a ThreadPool has tasks running.
 class ThreadNotifier {
   typedef std::pair<ThreadTask *, ThreadTask::State> Notification;
 
@@ -142,17 +237,47 @@ public:
 
   void notify(const Notification &);
 
+  struct Stats {
+    size_t depth; // notifications waiting for the main thread
+    size_t maxDepth;
+    size_t delivered;
+    double averageLatency; // in seconds from notify() to delivery
+    double maxLatency;
+    size_t ticks; // main thread timer callbacks
+    size_t idleTicks; // ticks with nothing to deliver
+  };
+
+  Stats stats() const;
+
 private:
+  typedef std::chrono::steady_clock Clock;
+
+  struct Node {
+    Notification notif;
+    Clock::time_point time;
+    Node *next;
+  };
+
   static ThreadNotifier *s_instance;
   static void tick();
 
-  ThreadNotifier() : m_active(0) {}
+  ThreadNotifier();
   ~ThreadNotifier() = default;
   void processQueue();
 
-  WDL_Mutex m_mutex;
   size_t m_active;
-  std::queue<Notification> m_queue;
+
+  // lock-free stack of pending notifications, newest first
+  std::atomic<Node *> m_head;
+  std::atomic<size_t> m_depth;
+
+  // updated by the main thread only
+  size_t m_maxDepth;
+  size_t m_delivered;
+  double m_totalLatency;
+  double m_maxLatency;
+  size_t m_ticks;
+  size_t m_idleTicks;
 };
 
 #endif
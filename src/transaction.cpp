@@ -21,8 +21,11 @@
 #include "config.hpp"
 #include "download.hpp"
 #include "errors.hpp"
+#include "filecache.hpp"
 #include "filesystem.hpp"
+#include "hash.hpp"
 #include "index.hpp"
+#include "journal.hpp"
 #include "remote.hpp"
 #include "task.hpp"
 
@@ -30,27 +33,54 @@
 
 using namespace std;
 
-Transaction::Transaction(Config *config)
-  : m_isCancelled(false), m_config(config),
-    m_registry(Path::prefixRoot(Path::REGISTRY))
+// the installed files of a repository are looked for at most this often,
+// the synchronizations in between only look at the changed packages
+static const time_t VERIFY_INTERVAL = 24 * 60 * 60;
+
+static bool HashFile(const Path &path, string *digest)
+{
+  ifstream stream;
+  return FS::open(stream, path) && Hash::file(stream, digest);
+}
+
+Transaction::Transaction(Config *config, ThreadPool *pool)
+  : m_isCancelled(false), m_isRunning(false), m_config(config),
+    m_registry(Path::prefixRoot(Path::REGISTRY)), m_tasks(pool),
+    m_batch(nullptr)
 {
   // don't keep pre-install pushes (for conflict checks); released in runTasks
   m_registry.savepoint();
 
-  m_threadPool.onPush([this] (ThreadTask *task) {
+  if(const int64_t maxSize = (int64_t)config->install.maxCacheSize << 20) {
+    try {
+      m_fileCache = make_unique<FileCache>(maxSize);
+    }
+    catch(const reapack_error &) {
+      // the download cache is optional, download everything again
+    }
+  }
+
+  m_journal = make_unique<Journal>(Path::DATA + "transaction.journal");
+
+  // the packages they belonged to are most likely not being installed anymore
+  FileDownload::expirePartials();
+
+  m_tasks.onPush([this] (ThreadTask *task) {
     task->onFinish([=] {
       if(task->state() == ThreadTask::Failure)
         m_receipt.addError(task->error());
     });
   });
 
-  m_threadPool.onAbort([this] {
-    m_isCancelled = true;
-    queue<HostTicket>().swap(m_regQueue);
-  });
+  // the tasks committed before cancellation are kept and registered
+  m_tasks.onAbort([this] { m_isCancelled = true; });
 
-  // run tasks after fetching indexes
-  m_threadPool.onDone(bind(&Transaction::runTasks, this));
+  // finish once every index and package download is done
+  m_tasks.onDone(bind(&Transaction::runTasks, this));
+}
+
+Transaction::~Transaction()
+{
 }
 
 void Transaction::synchronize(const Remote &remote,
@@ -69,6 +99,49 @@ void Transaction::synchronize(const Remote &remote,
     opts.autoInstall = remote.autoInstall();
 
   fetchIndex(remote, [=] {
+    Installed installed;
+    installed.options = (opts.autoInstall ? "+auto" : "") +
+      string(opts.bleedingEdge ? "+pre" : "");
+
+    string indexDigest;
+    if(HashFile(Index::pathFor(remote.name()), &indexDigest))
+      indexDigest += installed.options;
+
+    time_t verified;
+    const string &syncedDigest =
+      m_registry.getIndexDigest(remote.name(), &verified);
+
+    // the index and its packages are only looked at again if they changed
+    // since the last synchronization, unless some installed files went
+    // missing in the meantime
+    const time_t now = time(nullptr);
+    const bool verify = now - verified >= VERIFY_INTERVAL || now < verified;
+    installed.intact = true;
+
+    if(verify) {
+      // the installed files are queried at once and
+      // their directories are listed only once
+      for(const Registry::File &file : m_registry.getRemoteFiles(remote.name()))
+        installed.fingerprints[file.path] = file.fingerprint;
+
+      for(const auto &pair : installed.fingerprints) {
+        if(!fileListed(pair.first, &installed)) {
+          installed.intact = false;
+          break;
+        }
+      }
+
+      if(installed.intact)
+        verified = now;
+    }
+
+    if(installed.intact && !indexDigest.empty() && syncedDigest == indexDigest) {
+      if(verify)
+        m_registry.setIndexDigest(remote.name(), indexDigest, verified);
+
+      return;
+    }
+
     IndexPtr ri;
 
     try {
@@ -80,40 +153,98 @@ void Transaction::synchronize(const Remote &remote,
       return;
     }
 
-    for(const Package *pkg : ri->packages())
-      synchronize(pkg, opts);
+    for(const Registry::Entry &entry : m_registry.getEntries(ri->name()))
+      installed.entries[{entry.category, entry.package}] = entry;
+
+    const size_t obsoleteCount = m_obsolete.size();
 
     if(m_config->install.promptObsolete && !remote.isProtected()) {
-      for(const Registry::Entry &entry : m_registry.getEntries(ri->name())) {
+      for(const auto &pair : installed.entries) {
+        const Registry::Entry &entry = pair.second;
+
         if(!ri->find(entry.category, entry.package))
           m_obsolete.insert(entry);
       }
     }
+
+    // the new packages may take over the files of the obsolete ones:
+    // don't start them until the user chose what to uninstall
+    TaskQueue *queue = m_obsolete.size() > obsoleteCount ?
+      &m_heldQueue : &m_nextQueue;
+    const size_t queued = queue->size();
+
+    installed.digests = m_registry.getDigests(ri->name());
+
+    for(const Package *pkg : ri->packages())
+      synchronize(pkg, opts, &installed, queue);
+
+    // the digests left over belong to packages that are not tracked anymore
+    for(const auto &pair : installed.digests)
+      m_registry.forgetDigest(ri->name(), pair.first.first, pair.first.second);
+
+    // the next synchronizations skip this index until it changes
+    if(installed.intact && !indexDigest.empty() &&
+        queue->size() == queued && m_obsolete.size() == obsoleteCount)
+      m_registry.setIndexDigest(ri->name(), indexDigest, verified);
+
+    // download the packages of this remote without waiting for the other ones
+    if(m_isRunning)
+      startTasks();
   });
 }
 
-void Transaction::synchronize(const Package *pkg, const InstallOpts &opts)
+void Transaction::synchronize(const Package *pkg, const InstallOpts &opts,
+  Installed *installed, TaskQueue *queue)
 {
-  const auto &regEntry = m_registry.getEntry(pkg);
+  const pair<string, string> key{pkg->category()->name(), pkg->name()};
+  const auto it = installed->entries.find(key);
 
-  if(!regEntry && !opts.autoInstall)
+  // only the installed packages and the ones to install are tracked
+  if(it == installed->entries.end() && !opts.autoInstall)
     return;
 
+  // the options change the outcome as much as the package itself
+  const string &digest = pkg->digest() + installed->options;
+
+  const auto synced = installed->digests.find(key);
+  if(synced != installed->digests.end()) {
+    const bool unchanged = installed->intact && synced->second == digest;
+    installed->digests.erase(synced);
+
+    if(unchanged)
+      return; // nothing changed since the last synchronization
+  }
+
+  const Registry::Entry regEntry =
+    it != installed->entries.end() ? it->second : Registry::Entry{};
+
+  if(const Version *latest = outdated(pkg, opts, regEntry, installed))
+    queue->push(make_shared<InstallTask>(latest, false, regEntry, nullptr, this));
+  else
+    m_registry.setDigest(pkg, digest);
+}
+
+const Version *Transaction::outdated(const Package *pkg, const InstallOpts &opts,
+  const Registry::Entry &regEntry, Installed *installed)
+{
+  if(!regEntry && !opts.autoInstall)
+    return nullptr;
+
   const Version *latest = pkg->lastVersion(opts.bleedingEdge, regEntry.version);
 
   // don't crash nor install a pre-release if autoInstall is on with
   // bleedingEdge mode off and there is no stable release
   if(!latest)
-    return;
+    return nullptr;
 
   if(regEntry.version == latest->name()) {
-    if(allFilesExists(latest->files()))
-      return; // latest version is really installed, nothing to do here!
+    if(allFilesListed(latest->files(), installed))
+      return nullptr; // latest version is really installed, nothing to do here!
   }
   else if(regEntry.pinned || latest->name() < regEntry.version)
-    return;
+    return nullptr;
 
-  m_nextQueue.push(make_shared<InstallTask>(latest, false, regEntry, nullptr, this));
+  return latest;
 }
 
 void Transaction::fetchIndex(const Remote &remote, const function<void()> &cb)
@@ -133,7 +264,7 @@ void Transaction::fetchIndex(const Remote &remote, const function<void()> &cb)
       cb();
   });
 
-  m_threadPool.push(dl);
+  m_tasks.push(dl);
 }
 
 void Transaction::install(const Version *ver,
@@ -154,6 +285,47 @@ void Transaction::registerAll(const Remote &remote)
     inhibit(remote);
 }
 
+void Transaction::resume()
+{
+  map<string, IndexPtr> indexes;
+
+  for(const Journal::Plan &plan : m_journal->interrupted()) {
+    if(!plan.install) {
+      // confirmed again like obsolete packages: it may be long ago
+      for(const auto &entry : m_registry.getEntries(plan.remote)) {
+        if(entry.category == plan.category && entry.package == plan.package)
+          m_obsolete.insert(entry);
+      }
+
+      continue;
+    }
+
+    IndexPtr &ri = indexes[plan.remote];
+
+    try {
+      if(!ri)
+        ri = Index::load(plan.remote);
+
+      const Package *pkg = ri->find(plan.category, plan.package);
+      // the version may not exist anymore if the index was updated since
+      const Version *ver = pkg ? pkg->findVersion(plan.version) : nullptr;
+
+      if(!ver)
+        continue;
+
+      // the registry was committed before the transaction was interrupted
+      if(m_registry.getEntry(pkg).version == ver->name() &&
+          allFilesExists(ver->files()))
+        continue;
+
+      install(ver, plan.pin);
+    }
+    catch(const reapack_error &e) {
+      m_receipt.addError({e.what(), plan.remote});
+    }
+  }
+}
+
 void Transaction::setPinned(const Registry::Entry &entry, const bool pinned)
 {
   m_nextQueue.push(make_shared<PinTask>(entry, pinned, this));
@@ -165,15 +337,69 @@ void Transaction::uninstall(const Remote &remote)
 
   const Path &indexPath = Index::pathFor(remote.name());
 
-  if(FS::exists(indexPath)) {
-    if(!FS::remove(indexPath))
-      m_receipt.addError({FS::lastError(), indexPath.join()});
+  for(const Path &path : {indexPath, FileDownload::validatorsPathFor(indexPath)}) {
+    if(FS::exists(path) && !FS::remove(path))
+      m_receipt.addError({FS::lastError(), path.join()});
   }
 
   for(const auto &entry : m_registry.getEntries(remote.name()))
     uninstall(entry);
 }
 
+bool Transaction::download(FileDownload *dl)
+{
+  // the downloads of the same target (such as a package installed twice)
+  // would otherwise share a temporary file, a duplicate would remove it
+  const Path &target = dl->path().target();
+  if(const unsigned int count = m_downloadTargets[target]++)
+    dl->setPath({target, ".part" + to_string(count + 1)});
+
+  // connected before the slots of its task and of the thread pool, so the
+  // file is shared before it is moved into place and the pool never goes
+  // idle in between
+  dl->onFinish([=] { downloadDone(dl); });
+
+  SharedDownload &shared = m_downloads[dl->url()];
+
+  if(shared.current) {
+    shared.waiting.push_back(dl);
+    return false;
+  }
+
+  shared.current = dl;
+  return true;
+}
+
+void Transaction::downloadDone(FileDownload *dl)
+{
+  const auto it = m_downloads.find(dl->url());
+
+  // reused the file of another download
+  if(it == m_downloads.end() || it->second.current != dl)
+    return;
+
+  const vector<FileDownload *> waiting = move(it->second.waiting);
+  m_downloads.erase(it);
+
+  for(FileDownload *other : waiting) {
+    if(m_isCancelled)
+      other->abort();
+    else if(dl->state() != ThreadTask::Success || !other->reuse(*dl)) {
+      // downloaded again by the first of them, the other ones wait for it
+      SharedDownload &shared = m_downloads[other->url()];
+
+      if(shared.current) {
+        shared.waiting.push_back(other);
+        continue;
+      }
+
+      shared.current = other;
+    }
+
+    m_tasks.push(other);
+  }
+}
+
 void Transaction::uninstall(const Registry::Entry &entry)
 {
   m_nextQueue.push(make_shared<UninstallTask>(entry, this));
@@ -181,81 +407,223 @@ void Transaction::uninstall(const Registry::Entry &entry)
 
 bool Transaction::runTasks()
 {
-  if(!m_nextQueue.empty()) {
-    m_taskQueues.push(m_nextQueue);
-    TaskQueue().swap(m_nextQueue);
-  }
+  m_isRunning = true;
+  startTasks();
 
-  if(!commitTasks())
-    return false; // we're downloading indexes for synchronization
-  else if(m_isCancelled) {
-    finish();
-    return true;
-  }
+  // called again by m_tasks.onDone once the downloads are finished
+  if(!m_tasks.idle())
+    return false;
 
-  if(m_config->install.promptObsolete && !m_obsolete.empty()) {
+  if(!m_obsolete.empty()) {
     vector<Registry::Entry> selected;
     selected.insert(selected.end(), m_obsolete.begin(), m_obsolete.end());
     m_obsolete.clear();
 
-    if(m_promptObsolete(selected)) {
-      if(m_taskQueues.empty())
-        m_taskQueues.push(TaskQueue());
-
+    if(!m_isCancelled && m_promptObsolete(selected)) {
       for(const auto &entry : selected)
-        m_taskQueues.back().push(make_shared<UninstallTask>(entry, this));
+        m_nextQueue.push(make_shared<UninstallTask>(entry, this));
     }
-  }
-
-  while(!m_taskQueues.empty()) {
-    m_registry.savepoint();
-
-    auto &queue = m_taskQueues.front();
 
-    while(!queue.empty()) {
-      const TaskPtr &task = queue.top();
-
-      if(task->start())
-        m_runningTasks.push(task);
-
-      queue.pop();
+    // started after the uninstallations thanks to their lower priority
+    while(!m_heldQueue.empty()) {
+      m_nextQueue.push(m_heldQueue.top());
+      m_heldQueue.pop();
     }
 
-    m_registry.restore();
-    m_taskQueues.pop();
+    startTasks();
 
-    if(!commitTasks()) // if the tasks didn't finish immediately (downloading)
+    if(!m_tasks.idle())
       return false;
   }
 
-  // we're done!
+  // we're done! (partially if cancelled, the committed tasks are kept)
   m_registry.commit();
   registerQueued();
 
+  // nothing left to resume
+  m_journal->finish();
+
   finish();
 
   return true;
 }
 
-bool Transaction::commitTasks()
+void Transaction::startTasks()
 {
-  // wait until all running tasks are ready
-  if(!m_threadPool.idle())
+  if(m_nextQueue.empty())
+    return;
+
+  m_registry.savepoint();
+
+  // the packages still downloading or being committed own their files too
+  for(const auto &pair : m_runningTasks)
+    pair.second->claim();
+
+  for(Task *task : m_committingTasks)
+    task->claim();
+
+  vector<TaskPtr> started;
+
+  while(!m_nextQueue.empty()) {
+    const TaskPtr &task = m_nextQueue.top();
+
+    // queued tasks are dropped after cancellation
+    if(!m_isCancelled && task->start())
+      started.push_back(task);
+
+    m_nextQueue.pop();
+  }
+
+  m_registry.restore();
+
+  for(const TaskPtr &task : started) {
+    for(const Path &path : task->releasedFiles())
+      m_releasedFiles[path] = task.get();
+
+    m_runningTasks.emplace(task.get(), task);
+  }
+
+  // in priority order, so uninstallations free their files first
+  for(const TaskPtr &task : started) {
+    if(task->ready())
+      taskReady(task.get());
+  }
+}
+
+void Transaction::taskReady(Task *task)
+{
+  const auto it = m_runningTasks.find(task);
+
+  // not yet started or already done
+  if(it == m_runningTasks.end())
+    return;
+
+  m_readyTasks.push_back(move(it->second));
+  m_runningTasks.erase(it);
+
+  commitReady();
+}
+
+void Transaction::commitReady()
+{
+  bool progress;
+
+  do {
+    progress = false;
+
+    for(auto it = m_readyTasks.begin(); it != m_readyTasks.end();) {
+      if(isBlocked(**it)) {
+        it++;
+        continue;
+      }
+
+      const TaskPtr task = move(*it);
+      it = m_readyTasks.erase(it);
+
+      commitTask(task);
+      progress = true;
+    }
+
+    if(!progress && !m_readyTasks.empty())
+      progress = commitCycles();
+  } while(progress);
+
+  if(m_batch)
+    pushBatch();
+}
+
+bool Transaction::commitCycles()
+{
+  // Tasks installing the same package more than once (eg. two versions of it)
+  // take over the files released by each other. Different packages cannot
+  // exchange files as that is a conflict, so committing the tasks only
+  // waiting for each other in the order they were ready is enough.
+  unordered_set<const Task *> cycle;
+
+  for(const TaskPtr &task : m_readyTasks)
+    cycle.insert(task.get());
+
+  // leave out the ones waiting for a task still downloading
+  bool changed;
+
+  do {
+    changed = false;
+
+    for(auto it = cycle.begin(); it != cycle.end();) {
+      if(isBlocked(**it, cycle)) {
+        it = cycle.erase(it);
+        changed = true;
+      }
+      else
+        it++;
+    }
+  } while(changed);
+
+  if(cycle.empty())
     return false;
 
-  // finish current tasks
-  while(!m_runningTasks.empty()) {
-    if(m_isCancelled)
-      m_runningTasks.front()->rollback();
-    else
-      m_runningTasks.front()->commit();
+  for(auto it = m_readyTasks.begin(); it != m_readyTasks.end();) {
+    if(!cycle.count(it->get())) {
+      it++;
+      continue;
+    }
+
+    const TaskPtr task = move(*it);
+    it = m_readyTasks.erase(it);
 
-    m_runningTasks.pop();
+    commitTask(task);
   }
 
   return true;
 }
 
+bool Transaction::isBlocked(const Task &task,
+  const unordered_set<const Task *> &ignored) const
+{
+  for(const Path &path : task.takenFiles()) {
+    const auto it = m_releasedFiles.find(path);
+
+    if(it != m_releasedFiles.end() && it->second != &task &&
+        !ignored.count(it->second))
+      return true;
+  }
+
+  return false;
+}
+
+void Transaction::commitTask(const TaskPtr &task)
+{
+  if(m_isCancelled)
+    task->rollback();
+  else {
+    // the tasks without any file to move are still committed in order
+    if(!m_batch)
+      m_batch = new FileBatch;
+
+    m_committingTasks.insert(task.get());
+
+    m_batch->add(task->changes(), [=] (const FileBatch::Result &result) {
+      m_committingTasks.erase(task.get());
+      task->commit(result);
+    });
+  }
+
+  for(const Path &path : task->releasedFiles()) {
+    const auto it = m_releasedFiles.find(path);
+
+    if(it != m_releasedFiles.end() && it->second == task.get())
+      m_releasedFiles.erase(it);
+  }
+}
+
+void Transaction::pushBatch()
+{
+  // the files released by a task are removed before another one takes them
+  // over as the batches are run one after the other in a single thread
+  m_tasks.push(m_batch);
+  m_batch = nullptr;
+}
+
 void Transaction::finish()
 {
   m_onFinish();
@@ -272,6 +640,35 @@ bool Transaction::allFilesExists(const set<Path> &list) const
   return true;
 }
 
+bool Transaction::allFilesListed(const set<Path> &list, Installed *installed)
+{
+  for(const Path &path : list) {
+    if(!fileListed(path, installed))
+      return false;
+  }
+
+  return true;
+}
+
+bool Transaction::fileListed(const Path &path, Installed *installed)
+{
+  // only a missing file is a reason to install the package again:
+  // the changes made by the user to the installed files are kept
+  FS::Stat st;
+  if(!installed->snapshot.find(path, &st))
+    return false;
+
+  // installed by an older version of ReaPack, remember it if the listing
+  // told its size and modification time
+  const auto it = installed->fingerprints.find(path);
+  if(it != installed->fingerprints.end() && it->second.size < 0 && st.size >= 0) {
+    m_registry.setFingerprint(path, st);
+    it->second = st;
+  }
+
+  return true;
+}
+
 void Transaction::registerAll(const bool add, const Registry::Entry &entry)
 {
   // don't actually do anything until commit() – which will calls registerQueued
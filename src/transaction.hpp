@@ -26,12 +26,18 @@
 #include <boost/optional.hpp>
 #include <boost/signals2.hpp>
 #include <functional>
+#include <map>
 #include <memory>
+#include <queue>
 #include <set>
+#include <unordered_map>
 #include <unordered_set>
 
 class ArchiveReader;
 class Config;
+class FileCache;
+class FileDownload;
+class Journal;
 class Path;
 class Remote;
 struct InstallOpts;
@@ -46,7 +52,8 @@ public:
   typedef std::function<void()> CleanupHandler;
   typedef std::function<bool(std::vector<Registry::Entry> &)> ObsoleteHandler;
 
-  Transaction(Config *);
+  Transaction(Config *, ThreadPool *);
+  ~Transaction();
 
   void onFinish(const VoidSignal::slot_type &slot) { m_onFinish.connect(slot); }
   void setCleanupHandler(const CleanupHandler &cb) { m_cleanupHandler = cb; }
@@ -59,6 +66,9 @@ public:
   void uninstall(const Remote &);
   void uninstall(const Registry::Entry &);
   void registerAll(const Remote &);
+  // queues the tasks left over by an interrupted transaction,
+  // the uninstallations are confirmed through the obsolete handler
+  void resume();
   bool runTasks();
 
   bool isCancelled() const { return m_isCancelled; }
@@ -66,10 +76,17 @@ public:
   Receipt *receipt() { return &m_receipt; }
   Registry *registry() { return &m_registry; }
   const Config *config() { return m_config; }
-  ThreadPool *threadPool() { return &m_threadPool; }
+  FileCache *fileCache() { return m_fileCache.get(); }
+  Journal *journal() { return m_journal.get(); }
+  TaskGroup *tasks() { return &m_tasks; }
+  // returns false if the URL is already being downloaded: the download is
+  // then pushed once that one is done, to reuse its file or to try again
+  bool download(FileDownload *);
 
   void registerAll(bool add, const Registry::Entry &);
   void registerFile(const HostTicket &t) { m_regQueue.push(t); }
+  // commits (or rolls back) a started task once its files are in
+  void taskReady(Task *);
 
 private:
   class CompareTask {
@@ -83,16 +100,42 @@ private:
   typedef std::priority_queue<TaskPtr,
     std::vector<TaskPtr>, CompareTask> TaskQueue;
 
+  struct SharedDownload {
+    FileDownload *current;
+    std::vector<FileDownload *> waiting;
+  };
+
+  struct Installed {
+    std::map<std::pair<std::string, std::string>, Registry::Entry> entries;
+    std::map<Path, FS::Stat> fingerprints;
+    FileSnapshot snapshot;
+    bool intact; // no installed file was found missing
+    std::string options; // appended to the digests
+    Registry::Digests digests;
+  };
+
   void fetchIndex(const Remote &, const std::function<void ()> &);
-  void synchronize(const Package *, const InstallOpts &);
+  void downloadDone(FileDownload *);
+  void synchronize(const Package *, const InstallOpts &, Installed *, TaskQueue *);
   bool allFilesExists(const std::set<Path> &) const;
+  const Version *outdated(const Package *, const InstallOpts &,
+    const Registry::Entry &, Installed *);
+  bool allFilesListed(const std::set<Path> &, Installed *);
+  bool fileListed(const Path &, Installed *);
   void registerQueued();
   void registerScript(const HostTicket &, bool isLast);
   void inhibit(const Remote &);
-  bool commitTasks();
+  void startTasks();
+  void commitReady();
+  bool commitCycles();
+  bool isBlocked(const Task &,
+    const std::unordered_set<const Task *> &ignored = {}) const;
+  void commitTask(const TaskPtr &);
+  void pushBatch();
   void finish();
 
   bool m_isCancelled;
+  bool m_isRunning; // runTasks was called, queued tasks are started right away
   const Config *m_config;
   Registry m_registry;
   Receipt m_receipt;
@@ -101,10 +144,23 @@ private:
   std::unordered_set<std::string> m_inhibited;
   std::unordered_set<Registry::Entry> m_obsolete;
 
-  ThreadPool m_threadPool;
+  // must outlive the downloads of this transaction
+  std::unique_ptr<FileCache> m_fileCache;
+  std::unique_ptr<Journal> m_journal;
+  TaskGroup m_tasks;
+  // downloads in progress by URL, with the ones waiting for their file
+  std::unordered_map<std::string, SharedDownload> m_downloads;
+  std::map<Path, unsigned int> m_downloadTargets;
   TaskQueue m_nextQueue;
-  std::queue<TaskQueue> m_taskQueues;
-  std::queue<TaskPtr> m_runningTasks;
+  TaskQueue m_heldQueue; // waiting for the obsolete packages prompt
+  // started tasks waiting for their downloads
+  std::unordered_map<Task *, TaskPtr> m_runningTasks;
+  // waiting for the tasks releasing files they take over
+  std::vector<TaskPtr> m_readyTasks;
+  std::map<Path, Task *> m_releasedFiles;
+  // committed tasks waiting for their files to be moved into place
+  FileBatch *m_batch;
+  std::unordered_set<Task *> m_committingTasks;
   std::queue<HostTicket> m_regQueue;
 
   VoidSignal m_onFinish;
@@ -0,0 +1,317 @@
+/* ReaPack: Package manager for REAPER
+ * Copyright (C) 2015-2017  Christian Fillion
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "transport.hpp"
+
+#include "download.hpp"
+#include "ratelimit.hpp"
+#include "reapack.hpp"
+
+#include <boost/format.hpp>
+
+#include <reaper_plugin_functions.h>
+
+using boost::format;
+using namespace std;
+
+static const int DOWNLOAD_TIMEOUT = 15;
+
+static Transport::Factory g_factory;
+
+static CURLSH *g_curlShare = nullptr;
+// one lock per kind of shared data so DNS lookups don't wait for TLS sessions
+static WDL_Mutex g_curlMutexes[CURL_LOCK_DATA_LAST];
+
+static void LockCurlMutex(CURL *, curl_lock_data data, curl_lock_access, void *)
+{
+  g_curlMutexes[data].Enter();
+}
+
+static void UnlockCurlMutex(CURL *, curl_lock_data data, curl_lock_access, void *)
+{
+  g_curlMutexes[data].Leave();
+}
+
+void Transport::setFactory(const Factory &factory)
+{
+  g_factory = factory;
+}
+
+Transport *Transport::create()
+{
+  if(g_factory)
+    return g_factory();
+  else
+    return new CurlTransport;
+}
+
+bool Transport::write(Transfer *transfer, const char *data, const size_t size)
+{
+  return transfer->download->write(transfer, data, size);
+}
+
+void Transport::readHeader(Transfer *transfer, const string &line)
+{
+  transfer->download->readHeader(line);
+}
+
+bool Transport::progress(Transfer *transfer,
+  const int64_t received, const int64_t expected)
+{
+  transfer->received = received;
+  transfer->expected = expected;
+
+  return transfer->download->progress();
+}
+
+void Transport::complete(Transfer *transfer)
+{
+  m_context->complete(transfer);
+}
+
+struct CurlTransport::Handle {
+  CURL *curl;
+  curl_slist *headers;
+  CurlTransport *transport;
+  char errbuf[CURL_ERROR_SIZE];
+};
+
+void CurlTransport::GlobalInit()
+{
+  curl_global_init(CURL_GLOBAL_DEFAULT);
+
+  g_curlShare = curl_share_init();
+  assert(g_curlShare);
+
+  curl_share_setopt(g_curlShare, CURLSHOPT_LOCKFUNC, LockCurlMutex);
+  curl_share_setopt(g_curlShare, CURLSHOPT_UNLOCKFUNC, UnlockCurlMutex);
+
+  curl_share_setopt(g_curlShare, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+  curl_share_setopt(g_curlShare, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+}
+
+void CurlTransport::GlobalCleanup()
+{
+  curl_share_cleanup(g_curlShare);
+  curl_global_cleanup();
+}
+
+size_t CurlTransport::WriteData(char *data, size_t rawsize, size_t nmemb, void *ptr)
+{
+  const size_t size = rawsize * nmemb;
+  Transfer *transfer = static_cast<Transfer *>(ptr);
+  const Handle *handle = static_cast<Handle *>(transfer->data);
+
+  if(!transfer->responseCode) {
+    const char *url;
+    curl_easy_getinfo(handle->curl, CURLINFO_RESPONSE_CODE, &transfer->responseCode);
+    curl_easy_getinfo(handle->curl, CURLINFO_EFFECTIVE_URL, &url);
+    transfer->effectiveUrl = url;
+  }
+
+  if(!write(transfer, data, size))
+    return 0;
+
+  RateLimiter *limiter = RateLimiter::get();
+
+  if(limiter->limited()) {
+    limiter->consume(size);
+
+    // stop receiving until the bucket refills, perform() resumes the transfer
+    if(limiter->delay()) {
+      curl_easy_pause(handle->curl, CURLPAUSE_RECV);
+      handle->transport->m_throttled.insert(transfer);
+    }
+  }
+
+  return size;
+}
+
+size_t CurlTransport::ReadHeader(char *data, size_t rawsize, size_t nmemb, void *ptr)
+{
+  const size_t size = rawsize * nmemb;
+  readHeader(static_cast<Transfer *>(ptr), string(data, size));
+  return size;
+}
+
+int CurlTransport::UpdateProgress(void *ptr, const curl_off_t dltotal,
+    const curl_off_t dlnow, const curl_off_t, const curl_off_t)
+{
+  return !progress(static_cast<Transfer *>(ptr), dlnow, dltotal);
+}
+
+CurlTransport::CurlTransport()
+{
+  m_multi = curl_multi_init();
+
+  // Connections are cached by the multi handle. It lives as long as the
+  // worker thread of the shared ThreadPool, and every download goes through it.
+  // (libcurl cannot multiplex over connections shared between threads, so the
+  // connection cache is not put in g_curlShare.)
+  curl_multi_setopt(m_multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+}
+
+CurlTransport::~CurlTransport()
+{
+  curl_multi_cleanup(m_multi);
+}
+
+void CurlTransport::add(Transfer *transfer)
+{
+  const NetworkOpts &opts = transfer->download->options();
+
+  // connections exceeding these limits are queued by curl until a slot frees up
+  curl_multi_setopt(m_multi, CURLMOPT_MAX_TOTAL_CONNECTIONS,
+    static_cast<long>(opts.maxConnections));
+  curl_multi_setopt(m_multi, CURLMOPT_MAX_HOST_CONNECTIONS,
+    static_cast<long>(opts.maxHostConnections));
+
+  // by value: reapack-cli links the core objects without reapack.cpp
+  const auto userAgent = format("ReaPack/%s REAPER/%s")
+    % string(ReaPack::VERSION) % GetAppVersion();
+
+  Handle *handle = new Handle{curl_easy_init(), nullptr, this};
+  transfer->data = handle;
+
+  CURL *curl = handle->curl;
+
+  curl_easy_setopt(curl, CURLOPT_USERAGENT, userAgent.str().c_str());
+  curl_easy_setopt(curl, CURLOPT_LOW_SPEED_LIMIT, 1);
+  curl_easy_setopt(curl, CURLOPT_LOW_SPEED_TIME, DOWNLOAD_TIMEOUT);
+  curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, DOWNLOAD_TIMEOUT);
+  curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, true);
+  curl_easy_setopt(curl, CURLOPT_MAXREDIRS, 5);
+  // byte ranges of an encoded response cannot be decoded on their own
+  curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING,
+    transfer->range.empty() ? "" : nullptr);
+  curl_easy_setopt(curl, CURLOPT_FAILONERROR, true);
+  curl_easy_setopt(curl, CURLOPT_SHARE, g_curlShare);
+  curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, true);
+
+  // multiplex concurrent requests to the same host over a single connection
+  // (ignored when libcurl is built without HTTP/2 support)
+  curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
+  curl_easy_setopt(curl, CURLOPT_PIPEWAIT, true);
+  curl_easy_setopt(curl, CURLOPT_PRIVATE, transfer);
+
+  curl_easy_setopt(curl, CURLOPT_URL, transfer->url.c_str());
+  curl_easy_setopt(curl, CURLOPT_PROXY, opts.proxy.c_str());
+  curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, opts.verifyPeer);
+
+  curl_easy_setopt(curl, CURLOPT_NOPROGRESS, false);
+  curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, UpdateProgress);
+  curl_easy_setopt(curl, CURLOPT_XFERINFODATA, transfer);
+
+  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteData);
+  curl_easy_setopt(curl, CURLOPT_WRITEDATA, transfer);
+
+  if(transfer->primary) {
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, ReadHeader);
+    curl_easy_setopt(curl, CURLOPT_HEADERDATA, transfer);
+  }
+
+  if(!transfer->range.empty())
+    curl_easy_setopt(curl, CURLOPT_RANGE, transfer->range.c_str());
+
+  for(const string &header : transfer->headers)
+    handle->headers = curl_slist_append(handle->headers, header.c_str());
+  curl_easy_setopt(curl, CURLOPT_HTTPHEADER, handle->headers);
+
+  strcpy(handle->errbuf, "No details");
+  curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, handle->errbuf);
+
+  curl_multi_add_handle(m_multi, curl);
+}
+
+void CurlTransport::remove(Transfer *transfer)
+{
+  curl_multi_remove_handle(m_multi, static_cast<Handle *>(transfer->data)->curl);
+  m_throttled.erase(transfer);
+  release(transfer);
+}
+
+void CurlTransport::release(Transfer *transfer)
+{
+  Handle *handle = static_cast<Handle *>(transfer->data);
+
+  curl_easy_cleanup(handle->curl);
+  curl_slist_free_all(handle->headers);
+  delete handle;
+
+  transfer->data = nullptr;
+}
+
+void CurlTransport::resumeThrottled()
+{
+  if(m_throttled.empty() || RateLimiter::get()->delay())
+    return;
+
+  // the write callback may pause some of them again right away
+  const unordered_set<Transfer *> throttled = move(m_throttled);
+  m_throttled.clear();
+
+  for(Transfer *transfer : throttled)
+    curl_easy_pause(static_cast<Handle *>(transfer->data)->curl, CURLPAUSE_CONT);
+}
+
+void CurlTransport::perform()
+{
+  resumeThrottled();
+
+  int running;
+  curl_multi_perform(m_multi, &running);
+
+  int queued;
+  while(CURLMsg *msg = curl_multi_info_read(m_multi, &queued)) {
+    if(msg->msg != CURLMSG_DONE)
+      continue;
+
+    Transfer *transfer;
+    curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, &transfer);
+    const Handle *handle = static_cast<Handle *>(transfer->data);
+
+    curl_off_t received = 0, expected = 0;
+    curl_easy_getinfo(handle->curl, CURLINFO_RESPONSE_CODE, &transfer->responseCode);
+    curl_easy_getinfo(handle->curl, CURLINFO_SIZE_DOWNLOAD_T, &received);
+    curl_easy_getinfo(handle->curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &expected);
+    transfer->received = received;
+    transfer->expected = max<curl_off_t>(expected, 0);
+
+    const CURLcode result = msg->data.result;
+    if(result != CURLE_OK) {
+      transfer->error = (format("%s (%d): %s")
+        % curl_easy_strerror(result) % result % handle->errbuf).str();
+    }
+
+    remove(transfer);
+    complete(transfer);
+  }
+}
+
+void CurlTransport::poll(int timeout)
+{
+  // paused transfers have no network activity to wake up for
+  if(!m_throttled.empty())
+    timeout = min(timeout, RateLimiter::get()->delay());
+
+  curl_multi_poll(m_multi, nullptr, 0, timeout, nullptr);
+}
+
+void CurlTransport::wakeup()
+{
+  curl_multi_wakeup(m_multi);
+}
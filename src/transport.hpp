@@ -0,0 +1,119 @@
+/* ReaPack: Package manager for REAPER
+ * Copyright (C) 2015-2017  Christian Fillion
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef REAPACK_TRANSPORT_HPP
+#define REAPACK_TRANSPORT_HPP
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include <curl/curl.h>
+
+class Download;
+class DownloadContext;
+
+// One request of a download: the whole resource or a byte range of it.
+struct Transfer {
+  Download *download;
+
+  std::string url;
+  std::vector<std::string> headers;
+  std::string range; // "first-[last]", empty for the whole resource
+  bool primary; // only the primary transfer receives the response headers
+
+  // filled in by the transport
+  long responseCode;
+  std::string effectiveUrl;
+  int64_t received;
+  int64_t expected; // 0 if unknown
+  std::string error; // empty on success
+
+  // used by Download
+  bool receiving;
+  int64_t offset; // position of the next received byte in the output
+
+  void *data; // reserved for the transport
+};
+
+// Carries the transfers of one worker thread. The default implementation
+// uses libcurl, others may be installed for testing or benchmarking.
+class Transport {
+public:
+  typedef std::function<Transport *()> Factory;
+
+  // the factory is used for the worker threads created afterwards
+  static void setFactory(const Factory &);
+  static Transport *create();
+
+  virtual ~Transport() {}
+
+  void setContext(DownloadContext *ctx) { m_context = ctx; }
+
+  virtual void add(Transfer *) = 0;
+  // stops the transfer without reporting its completion
+  virtual void remove(Transfer *) = 0;
+  // processes the network activity and reports completed transfers
+  virtual void perform() = 0;
+  // waits at most timeout milliseconds for network activity
+  virtual void poll(int timeout) = 0;
+  // interrupts perform() from any thread
+  virtual void wakeup() = 0;
+
+protected:
+  // to be called from perform() only
+  static bool write(Transfer *, const char *, size_t);
+  static void readHeader(Transfer *, const std::string &line);
+  static bool progress(Transfer *, int64_t received, int64_t expected);
+  void complete(Transfer *);
+
+private:
+  DownloadContext *m_context;
+};
+
+class CurlTransport : public Transport {
+public:
+  static void GlobalInit();
+  static void GlobalCleanup();
+
+  CurlTransport();
+  ~CurlTransport();
+
+  void add(Transfer *) override;
+  void remove(Transfer *) override;
+  void perform() override;
+  void poll(int timeout) override;
+  void wakeup() override;
+
+private:
+  struct Handle;
+
+  static size_t WriteData(char *, size_t, size_t, void *);
+  static size_t ReadHeader(char *, size_t, size_t, void *);
+  static int UpdateProgress(void *, curl_off_t, curl_off_t, curl_off_t, curl_off_t);
+  static void release(Transfer *);
+  void resumeThrottled();
+
+  CURLM *m_multi;
+  // paused by the rate limiter
+  std::unordered_set<Transfer *> m_throttled;
+};
+
+#endif
@@ -0,0 +1,184 @@
+#include <catch.hpp>
+
+#include <callback.hpp>
+
+#include <boost/signals2.hpp>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static const char *M = "[callback]";
+
+static bool g_countAllocs = false;
+static size_t g_allocs = 0;
+
+void *operator new(const size_t size)
+{
+  if(g_countAllocs)
+    g_allocs++;
+
+  if(void *ptr = malloc(size))
+    return ptr;
+
+  throw bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept { free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { free(ptr); }
+
+static size_t CountAllocs(const function<void ()> &func)
+{
+  g_allocs = 0;
+  g_countAllocs = true;
+  func();
+  g_countAllocs = false;
+  return g_allocs;
+}
+
+TEST_CASE("small callbacks are stored inline", M) {
+  int a = 0, b = 0;
+
+  REQUIRE(CountAllocs([&] {
+    Callback<void ()> cb([&a, &b] { a++; b++; });
+    Callback<void ()> copy(cb);
+    copy();
+    cb();
+  }) == 0);
+
+  REQUIRE(a == 2);
+  REQUIRE(b == 2);
+
+  string big(100, 'x');
+  size_t size = 0;
+
+  REQUIRE(CountAllocs([&] {
+    Callback<void ()> cb([big, &size] { size = big.size(); });
+    cb();
+  }) == 2); // the lambda and its string
+
+  REQUIRE(size == 100);
+}
+
+TEST_CASE("callback with arguments", M) {
+  Callback<int (int, int)> cb([] (int a, int b) { return a + b; });
+  REQUIRE(cb(2, 3) == 5);
+
+  Callback<int (int, int)> other;
+  REQUIRE_FALSE(other);
+  other = cb;
+  REQUIRE(other);
+  REQUIRE(other(1, 1) == 2);
+}
+
+TEST_CASE("signal emission", M) {
+  Signal<void (int)> signal;
+  vector<int> calls;
+
+  for(int i = 0; i < 10; i++)
+    signal.connect([&, i] (int v) { calls.push_back(i * v); });
+
+  signal(2);
+
+  REQUIRE(calls == vector<int>{0, 2, 4, 6, 8, 10, 12, 14, 16, 18});
+}
+
+TEST_CASE("signal disconnection", M) {
+  Signal<void ()> signal;
+  vector<int> calls;
+
+  signal.connect([&] { calls.push_back(1); });
+  const auto &conn = signal.connect([&] { calls.push_back(2); });
+  signal.connect([&] { calls.push_back(3); });
+
+  SECTION("before emission") {
+    conn.disconnect();
+    signal();
+    REQUIRE(calls == vector<int>{1, 3});
+  }
+
+  SECTION("all slots") {
+    signal.disconnect_all_slots();
+    signal();
+    REQUIRE(calls.empty());
+  }
+}
+
+TEST_CASE("modify signal during emission", M) {
+  Signal<void ()> signal;
+  vector<int> calls;
+  Signal<void ()>::Connection self, next;
+
+  self = signal.connect([&] {
+    calls.push_back(1);
+    self.disconnect();
+    next.disconnect();
+
+    for(int i = 0; i < 10; i++)
+      signal.connect([&] { calls.push_back(4); });
+  });
+  next = signal.connect([&] { calls.push_back(2); });
+  signal.connect([&] { calls.push_back(3); });
+
+  signal();
+  REQUIRE(calls == vector<int>{1, 3});
+
+  calls.clear();
+  signal();
+  REQUIRE(calls == vector<int>{3, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4});
+}
+
+TEST_CASE("signal without allocation", M) {
+  int calls = 0;
+
+  REQUIRE(CountAllocs([&] {
+    Signal<void ()> signal;
+    for(int i = 0; i < 6; i++)
+      signal.connect([&calls] { calls++; });
+    signal();
+  }) == 0);
+
+  REQUIRE(calls == 6);
+}
+
+// the slots a task gets during an installation: 2 on start, 6 on finish
+template<typename VoidSignal>
+static void TaskLifetime(int *calls)
+{
+  VoidSignal onStart, onFinish;
+  void *task = &onStart;
+
+  for(int i = 0; i < 2; i++)
+    onStart.connect([=] { (*calls)++; (void)task; });
+  for(int i = 0; i < 6; i++)
+    onFinish.connect([=] { (*calls)++; (void)task; });
+
+  onStart();
+  onFinish();
+}
+
+template<typename VoidSignal>
+static void Benchmark(const char *name)
+{
+  const int tasks = 100000;
+  int calls = 0;
+
+  const size_t allocs = CountAllocs([&] { TaskLifetime<VoidSignal>(&calls); });
+
+  const auto start = chrono::steady_clock::now();
+  for(int i = 0; i < tasks; i++)
+    TaskLifetime<VoidSignal>(&calls);
+  const chrono::duration<double, nano> elapsed = chrono::steady_clock::now() - start;
+
+  cout << name << ": " << allocs << " allocations and "
+    << elapsed.count() / tasks << " ns per task" << endl;
+}
+
+// run with: test '[benchmark]'
+TEST_CASE("task signals overhead", "[.benchmark]") {
+  Benchmark<boost::signals2::signal<void ()>>("boost::signals2");
+  Benchmark<Signal<void ()>>("Signal");
+}
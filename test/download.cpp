@@ -0,0 +1,298 @@
+#include <catch.hpp>
+
+#include "helper/api.hpp"
+#include "helper/fs.hpp"
+#include "helper/http.hpp"
+
+#include <download.hpp>
+#include <filesystem.hpp>
+#include <journal.hpp>
+
+using namespace std;
+
+static const char *M = "[download]";
+
+static ThreadTask::State Run(FileDownload *dl)
+{
+  bool done = false;
+  dl->onFinish([&] { done = true; });
+  dl->setCleanupHandler([] {});
+
+  ThreadPool pool;
+  pool.push(dl);
+
+  RunTimers([&] { return done; });
+
+  return dl->state();
+}
+
+static void RemovePartialDir()
+{
+  const Path &dir = FileDownload::partialPathFor(Path("any")).dirname();
+
+  for(const Path &path : {dir, Path::CACHE, Path::DATA})
+    FS::remove(path);
+}
+
+TEST_CASE("resume interrupted download", M) {
+  UseStubApi();
+  DownloadContext::GlobalInit();
+  UseRootPath root("test");
+
+  const NetworkOpts opts{"", true, 4, 4};
+  const Path target("download.bin");
+  const TempPath paths(target);
+  const Path &resumeInfo = FileDownload::validatorsPathFor(paths.temp());
+  const Path &partial = FileDownload::partialPathFor(paths.temp());
+
+  string body(100000, '\0');
+  for(size_t i = 0; i < body.size(); i++)
+    body[i] = 'a' + i % 26;
+
+  HttpServer server;
+  server.setResource(body, "\"first\"");
+  server.setCutAfter(40000);
+
+  {
+    FileDownload dl(target, server.url(), opts);
+    REQUIRE(Run(&dl) == ThreadTask::Failure);
+    REQUIRE(dl.save());
+  }
+
+  // kept out of the way until the next attempt
+  REQUIRE_FALSE(FS::exists(paths.temp()));
+  REQUIRE_FALSE(FS::exists(resumeInfo));
+
+  int64_t size;
+  REQUIRE(FS::size(partial, &size));
+  REQUIRE(size == 40000);
+  REQUIRE(FS::exists(FileDownload::validatorsPathFor(partial)));
+
+  server.setCutAfter(0);
+
+  SECTION("unchanged") {
+    FileDownload dl(target, server.url(), opts);
+    REQUIRE(Run(&dl) == ThreadTask::Success);
+    REQUIRE(dl.save());
+
+    const string &request = server.requests().back();
+    REQUIRE(request.find("Range: bytes=40000-") != string::npos);
+    REQUIRE(request.find("If-Range: \"first\"") != string::npos);
+    REQUIRE(server.statuses().back() == 206);
+    REQUIRE(Contents(target) == body);
+  }
+
+  SECTION("modified") {
+    body[0] = 'z';
+    server.setResource(body, "\"second\"");
+
+    FileDownload dl(target, server.url(), opts);
+    REQUIRE(Run(&dl) == ThreadTask::Success);
+    REQUIRE(dl.save());
+
+    REQUIRE(server.statuses().back() == 200);
+    REQUIRE(Contents(target) == body);
+  }
+
+  REQUIRE_FALSE(FS::exists(paths.temp()));
+  REQUIRE_FALSE(FS::exists(resumeInfo));
+  REQUIRE_FALSE(FS::exists(partial));
+
+  FS::remove(target);
+  RemovePartialDir();
+  DownloadContext::GlobalCleanup();
+}
+
+TEST_CASE("expire partial downloads", M) {
+  UseRootPath root("test");
+
+  const Path &kept = FileDownload::partialPathFor(Path("kept.bin.part"));
+  const Path &orphan = FileDownload::partialPathFor(Path("orphan.bin.part"));
+
+  REQUIRE(FS::write(kept, "kept"));
+  REQUIRE(FS::write(FileDownload::validatorsPathFor(kept), "ETag: \"first\"\n"));
+  REQUIRE(FS::write(orphan, "orphan"));
+
+  FileDownload::expirePartials();
+
+  REQUIRE(FS::exists(kept));
+  REQUIRE(FS::exists(FileDownload::validatorsPathFor(kept)));
+  REQUIRE_FALSE(FS::exists(orphan));
+
+  FS::remove(FileDownload::validatorsPathFor(kept));
+  FS::remove(kept);
+  RemovePartialDir();
+}
+
+TEST_CASE("segmented download", M) {
+  UseStubApi();
+  DownloadContext::GlobalInit();
+  UseRootPath root("test");
+
+  const NetworkOpts opts{"", true, 4, 4};
+  const Path target("download.bin");
+
+  string body(10 << 20, '\0');
+  for(size_t i = 0; i < body.size(); i++)
+    body[i] = 'a' + i % 26;
+
+  HttpServer server;
+  server.setResource(body, "\"first\"");
+
+  {
+    FileDownload dl(target, server.url(), opts, Download::SegmentedFlag);
+    REQUIRE(Run(&dl) == ThreadTask::Success);
+    REQUIRE(dl.save());
+
+    REQUIRE(dl.bytesReceived() == (int64_t)body.size());
+    REQUIRE(dl.bytesTotal() == (int64_t)body.size());
+    REQUIRE(dl.totalTime() >= dl.timeToFirstByte());
+    REQUIRE(dl.throughput() > 0);
+  }
+
+  const vector<string> &requests = server.requests();
+  REQUIRE(requests.size() == 3);
+  REQUIRE(requests[0].find("Range: bytes=0-4194303") != string::npos);
+
+  // the other segments are requested concurrently, in any order
+  const string &segments = requests[1] + requests[2];
+  REQUIRE(segments.find("Range: bytes=4194304-7340031") != string::npos);
+  REQUIRE(segments.find("Range: bytes=7340032-10485759") != string::npos);
+
+  for(const int status : server.statuses())
+    REQUIRE(status == 206);
+
+  for(size_t i = 1; i < requests.size(); i++)
+    REQUIRE(requests[i].find("If-Range: \"first\"") != string::npos);
+
+  REQUIRE(Contents(target) == body);
+
+  FS::remove(target);
+  DownloadContext::GlobalCleanup();
+}
+
+TEST_CASE("segmented download of unknown size", M) {
+  UseStubApi();
+  DownloadContext::GlobalInit();
+  UseRootPath root("test");
+
+  const NetworkOpts opts{"", true, 4, 4};
+  const Path target("download.bin");
+
+  const string body(6 << 20, 'x');
+
+  HttpServer server;
+  server.setResource(body, "\"first\"");
+  server.setUnknownLength(true);
+
+  {
+    FileDownload dl(target, server.url(), opts, Download::SegmentedFlag);
+    REQUIRE(Run(&dl) == ThreadTask::Success);
+    REQUIRE(dl.save());
+  }
+
+  // the whole file is requested again without a range
+  const vector<string> &requests = server.requests();
+  REQUIRE(requests.size() == 2);
+  REQUIRE(requests[0].find("Range: bytes=0-4194303") != string::npos);
+  REQUIRE(requests[1].find("Range:") == string::npos);
+  REQUIRE(server.statuses().back() == 200);
+
+  REQUIRE(Contents(target) == body);
+
+  FS::remove(target);
+  DownloadContext::GlobalCleanup();
+}
+
+TEST_CASE("record finished download in the journal", M) {
+  UseStubApi();
+  DownloadContext::GlobalInit();
+  UseRootPath root("test");
+
+  const NetworkOpts opts{"", true, 4, 4};
+  const Path target("download.bin");
+  const TempPath paths(target);
+
+  HttpServer server;
+  server.setResource("hello world", "\"first\"");
+
+  {
+    Journal journal(Path("journal.txt"));
+
+    // hashed by a parallel worker before finishing
+    FileDownload dl(target, server.url(), opts);
+    dl.setJournal(&journal);
+    REQUIRE(Run(&dl) == ThreadTask::Success);
+
+    REQUIRE(journal.fetch(server.url(), paths));
+    REQUIRE(Contents(paths.temp()) == "hello world");
+
+    journal.finish();
+  }
+
+  FS::remove(paths.temp());
+  FS::remove(Path("journal.txt.lock"));
+  DownloadContext::GlobalCleanup();
+}
+
+TEST_CASE("reuse connections across downloads", M) {
+  UseStubApi();
+  DownloadContext::GlobalInit();
+
+  const NetworkOpts opts{"", true, 4, 4};
+
+  HttpServer server;
+  server.setResource("hello world", "\"first\"");
+  server.setKeepAlive(true);
+
+  {
+    ThreadPool pool;
+
+    for(int i = 0; i < 3; i++) {
+      bool done = false;
+      MemoryDownload *dl = new MemoryDownload(server.url(), opts);
+      dl->onFinish([&] { done = true; });
+      dl->setCleanupHandler([=] { delete dl; });
+      pool.push(dl);
+
+      REQUIRE(RunTimers([&] { return done; }));
+    }
+  }
+
+  REQUIRE(server.requests().size() == 3);
+  REQUIRE(server.connections() == 1);
+
+  DownloadContext::GlobalCleanup();
+}
+
+TEST_CASE("abort stalled download", M) {
+  UseStubApi();
+  DownloadContext::GlobalInit();
+
+  const NetworkOpts opts{"", true, 4, 4};
+
+  HttpServer server;
+  server.setStalled(true);
+
+  {
+    ThreadPool pool;
+
+    MemoryDownload dl(server.url(), opts);
+    bool done = false;
+    dl.onFinish([&] { done = true; });
+    dl.setCleanupHandler([] {});
+    pool.push(&dl);
+
+    REQUIRE(RunTimers([&] { return server.requests().size() == 1; }));
+
+    const auto start = chrono::steady_clock::now();
+    dl.abort();
+    REQUIRE(RunTimers([&] { return done; }));
+    const chrono::duration<double> latency = chrono::steady_clock::now() - start;
+
+    REQUIRE(dl.state() == ThreadTask::Aborted);
+    REQUIRE(latency.count() < 0.1);
+  }
+
+  DownloadContext::GlobalCleanup();
+}
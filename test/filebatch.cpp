@@ -0,0 +1,140 @@
+#include <catch.hpp>
+
+#include "helper/api.hpp"
+
+#include <filebatch.hpp>
+#include <filesystem.hpp>
+
+using namespace std;
+
+static const char *M = "[filebatch]";
+
+static void Run(FileBatch *batch, const bool abort = false)
+{
+  bool done = false;
+  batch->onFinish([&] { done = true; });
+  batch->setCleanupHandler([] {});
+
+  ThreadPool pool;
+
+  if(abort)
+    batch->abort();
+
+  pool.push(batch);
+
+  RunTimers([&] { return done; });
+}
+
+TEST_CASE("commit file changes in order", M) {
+  UseStubApi();
+  UseRootPath root("test");
+
+  const TempPath first(Path("filebatch_a.txt")), second(Path("filebatch_b.txt"));
+  REQUIRE(FS::write(first.temp(), "new a"));
+  REQUIRE(FS::write(second.temp(), "new b"));
+  REQUIRE(FS::write(first.target(), "old a"));
+
+  vector<int> calls;
+  FileBatch::Result install, uninstall;
+
+  {
+    FileBatch batch;
+
+    FileBatch::Changes changes;
+    changes.renames = {first};
+    batch.add(changes, [&] (const FileBatch::Result &r) {
+      calls.push_back(1);
+      install = r;
+    });
+
+    // takes over the file renamed just before
+    changes = {};
+    changes.recursive = true;
+    changes.removals = {first.target(), Path("filebatch_missing.txt")};
+    batch.add(changes, [&] (const FileBatch::Result &r) {
+      calls.push_back(2);
+      uninstall = r;
+    });
+
+    changes = {};
+    changes.renames = {second};
+    batch.add(changes, [&] (const FileBatch::Result &) { calls.push_back(3); });
+
+    REQUIRE_FALSE(batch.empty());
+    Run(&batch);
+  }
+
+  REQUIRE(calls == vector<int>({1, 2, 3}));
+
+  REQUIRE(install.status == FileBatch::Committed);
+  REQUIRE(install.removals.empty());
+
+  REQUIRE(uninstall.status == FileBatch::Committed);
+  REQUIRE(uninstall.removals.size() == 2);
+  REQUIRE(uninstall.removals[0].existed);
+  REQUIRE(uninstall.removals[0].removed);
+  REQUIRE_FALSE(uninstall.removals[1].existed);
+
+  REQUIRE_FALSE(FS::exists(first.target()));
+  REQUIRE_FALSE(FS::exists(first.temp()));
+  REQUIRE(FS::exists(second.target()));
+  REQUIRE_FALSE(FS::exists(second.temp()));
+
+  FS::remove(second.target());
+}
+
+TEST_CASE("discard temporary files of failed commit", M) {
+  UseStubApi();
+  UseRootPath root("test");
+
+  const TempPath good(Path("filebatch_good.txt"));
+  const TempPath bad(Path("filebatch_nodir/bad.txt"));
+  const Path old("filebatch_old.txt");
+  REQUIRE(FS::write(good.temp(), "good"));
+  REQUIRE(FS::write(old, "old"));
+
+  FileBatch::Result result;
+
+  {
+    FileBatch batch;
+    FileBatch::Changes changes;
+    changes.renames = {bad, good}; // the temporary file of bad is missing
+    changes.removals = {old};
+    batch.add(changes, [&] (const FileBatch::Result &r) { result = r; });
+
+    Run(&batch);
+  }
+
+  REQUIRE(result.status == FileBatch::Failed);
+  REQUIRE(result.error.context == bad.target().join());
+  REQUIRE(result.removals.empty());
+
+  REQUIRE_FALSE(FS::exists(good.temp()));
+  REQUIRE_FALSE(FS::exists(good.target()));
+  REQUIRE(FS::exists(old)); // not removed
+
+  FS::remove(old);
+}
+
+TEST_CASE("cancel file changes", M) {
+  UseStubApi();
+  UseRootPath root("test");
+
+  const TempPath paths(Path("filebatch_cancel.txt"));
+  REQUIRE(FS::write(paths.temp(), "new"));
+
+  FileBatch::Result result;
+  result.status = FileBatch::Committed;
+
+  FileBatch batch;
+  FileBatch::Changes changes;
+  changes.renames = {paths};
+  batch.add(changes, [&] (const FileBatch::Result &r) { result = r; });
+
+  Run(&batch, true);
+
+  REQUIRE(batch.state() == ThreadTask::Aborted);
+  REQUIRE(result.status == FileBatch::Cancelled);
+  REQUIRE_FALSE(FS::exists(paths.temp()));
+  REQUIRE_FALSE(FS::exists(paths.target()));
+}
@@ -0,0 +1,62 @@
+#include <catch.hpp>
+
+#include "helper/api.hpp"
+#include "helper/fs.hpp"
+
+#include <filecache.hpp>
+#include <filesystem.hpp>
+#include <hash.hpp>
+
+using namespace std;
+
+static const char *M = "[filecache]";
+
+static const string URL("http://example.com/file");
+
+TEST_CASE("cached files are looked up by URL and version", M) {
+  UseStubApi();
+  UseRootPath root("test");
+  FS::mkdir(Path::CACHE);
+
+  const Path file("filecache.bin");
+  REQUIRE(FS::write(file, "hello world"));
+
+  {
+    Hash hash;
+    hash.addData("hello world");
+
+    FileCache cache(1 << 20);
+    cache.store(URL, "remote/cat/pkg 1.0", file, hash.digest(), 11);
+  }
+
+  const Path target("filecache_target.bin");
+
+  {
+    FileCache cache(1 << 20);
+
+    REQUIRE_FALSE(cache.fetch(URL, "remote/cat/pkg 1.1", target));
+    REQUIRE_FALSE(cache.fetch("http://example.com/other", "remote/cat/pkg 1.0", target));
+
+    REQUIRE(cache.fetch(URL, "remote/cat/pkg 1.0", target));
+    REQUIRE(Contents(target) == "hello world");
+
+    SECTION("installed files are independent copies") {
+      REQUIRE(FS::write(target, "modified"));
+
+      const Path other("filecache_other.bin");
+      REQUIRE(cache.fetch(URL, "remote/cat/pkg 1.0", other));
+      REQUIRE(Contents(other) == "hello world");
+      FS::remove(other);
+    }
+  }
+
+  FS::remove(target);
+  FS::remove(file);
+
+  const Path &dir = Path::CACHE + "files";
+  FS::remove(dir + "b94d27b9934d3e08a52e52d7da7dabfac484efe37a5380ee9088f7ace2efcde9");
+  FS::remove(dir);
+  FS::remove(Path::CACHE + "files.db");
+  FS::remove(Path::CACHE);
+  FS::remove(Path::DATA);
+}
@@ -1,8 +1,12 @@
 #include <catch.hpp>
 
+#include "helper/api.hpp"
+
 #include <filesystem.hpp>
 #include <index.hpp>
 
+using namespace std;
+
 static const char *M = "[filesystem]";
 
 #define RIPATH "test/indexes"
@@ -22,3 +26,38 @@ TEST_CASE("unicode filename", M) {
     REQUIRE(FS::mtime(path, &time));
   }
 }
+
+TEST_CASE("list directory", M) {
+  UseStubApi();
+  UseRootPath root("test");
+
+  const Path dir("fs_list");
+  REQUIRE(FS::write(dir + "a.txt", "hello"));
+  REQUIRE(FS::write(dir + "sub" + "b.txt", "world!"));
+
+  map<string, FS::Stat> files;
+  REQUIRE(FS::list(dir, &files));
+  REQUIRE(files.size() == 1); // directories are skipped
+  REQUIRE(files.count("a.txt"));
+
+  FS::Stat st;
+  REQUIRE(FS::stat(dir + "a.txt", &st));
+#ifdef _WIN32
+  REQUIRE(files["a.txt"] == st);
+#else
+  REQUIRE(files["a.txt"].size == -1); // not given by readdir
+#endif
+
+  REQUIRE_FALSE(FS::list(Path("fs_missing"), &files));
+
+  FileSnapshot snapshot;
+  REQUIRE(snapshot.find(dir + "a.txt"));
+  REQUIRE(snapshot.find(dir + "sub" + "b.txt", &st));
+  REQUIRE_FALSE(snapshot.find(dir + "c.txt", &st));
+  REQUIRE_FALSE(snapshot.find(Path("fs_missing") + "d.txt", &st));
+
+  FS::remove(dir + "sub" + "b.txt");
+  FS::remove(dir + "sub");
+  FS::remove(dir + "a.txt");
+  FS::remove(dir);
+}
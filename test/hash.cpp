@@ -0,0 +1,49 @@
+#include <catch.hpp>
+
+#include <hash.hpp>
+
+#include <sstream>
+
+using namespace std;
+
+static const char *M = "[hash]";
+
+TEST_CASE("sha256 of empty input", M) {
+  Hash hash;
+  REQUIRE(hash.digest() ==
+    "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+}
+
+TEST_CASE("sha256 of short input", M) {
+  Hash hash;
+  hash.addData("abc");
+  REQUIRE(hash.digest() ==
+    "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+}
+
+TEST_CASE("sha256 of multi-block input", M) {
+  Hash hash;
+
+  SECTION("single call") {
+    hash.addData("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq");
+  }
+
+  SECTION("split calls") {
+    hash.addData("abcdbcdecdefdefgefghfghighij");
+    hash.addData("hijkijkljklmklmnlmnomnopnopq");
+  }
+
+  REQUIRE(hash.digest() ==
+    "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+}
+
+TEST_CASE("sha256 of a stream", M) {
+  istringstream stream(string(10000, 'a'));
+
+  string digest;
+  int64_t size = 0;
+  REQUIRE(Hash::file(stream, &digest, &size));
+  REQUIRE(size == 10000);
+  REQUIRE(digest ==
+    "27dd1f61b867b6a0f6e9d8a41c43231de52107e53ae424de8f847b821db4b711");
+}
@@ -0,0 +1,97 @@
+#include "api.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include <reaper_plugin_functions.h>
+
+#ifdef _WIN32
+#  include <direct.h>
+#  define mkdir(path, mode) _mkdir(path)
+#else
+#  include <sys/stat.h>
+#endif
+
+using namespace std;
+
+static void (*g_timer)() = nullptr;
+static int g_playState = 0;
+
+static int PluginRegister(const char *name, void *info)
+{
+  if(!strcmp(name, "timer"))
+    g_timer = (void (*)())info;
+  else if(!strcmp(name, "-timer"))
+    g_timer = nullptr;
+
+  return 1;
+}
+
+static const char *AppVersion() { return "5.0"; }
+static int PlayState() { return g_playState; }
+static int MakeDirectory(const char *path, size_t)
+{
+  string partial;
+
+  for(const char *c = path; *c; c++) {
+    if((*c == '/' || *c == '\\') && !partial.empty())
+      mkdir(partial.c_str(), 0777);
+
+    partial += *c;
+  }
+
+  mkdir(partial.c_str(), 0777);
+  return 1;
+}
+
+static bool FileExists(const char *path)
+{
+  FILE *file = fopen(path, "rb");
+  if(file)
+    fclose(file);
+  return file != nullptr;
+}
+
+void UseStubApi()
+{
+  plugin_register = PluginRegister;
+  GetAppVersion = AppVersion;
+  RecursiveCreateDirectory = MakeDirectory;
+  file_exists = FileExists;
+  GetPlayState = PlayState;
+}
+
+bool RunTimers(const function<bool ()> &done, const int timeout)
+{
+  const auto end = chrono::steady_clock::now() + chrono::milliseconds(timeout);
+
+  while(!done() && chrono::steady_clock::now() < end) {
+    if(g_timer)
+      g_timer();
+    this_thread::sleep_for(chrono::milliseconds(5));
+  }
+
+  if(g_timer)
+    g_timer();
+
+  return done();
+}
+
+bool HasTimer()
+{
+  return g_timer != nullptr;
+}
+
+void TickTimer(int times)
+{
+  while(g_timer && times--)
+    g_timer();
+}
+
+void SetPlayState(const int state)
+{
+  g_playState = state;
+}
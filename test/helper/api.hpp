@@ -0,0 +1,20 @@
+#ifndef REAPACK_TEST_HELPER_API_HPP
+#define REAPACK_TEST_HELPER_API_HPP
+
+#include <functional>
+
+// install the few REAPER API functions needed by the worker threads
+void UseStubApi();
+
+// run the timers registered with plugin_register until done() returns true
+bool RunTimers(const std::function<bool ()> &done, int timeout = 10000);
+
+// true if a timer is currently registered
+bool HasTimer();
+// call the registered timer that many times without waiting
+void TickTimer(int times = 1);
+
+// value returned by GetPlayState (1: playing, 2: paused, 4: recording)
+void SetPlayState(int);
+
+#endif
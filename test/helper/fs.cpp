@@ -0,0 +1,15 @@
+#include "fs.hpp"
+
+#include <filesystem.hpp>
+
+#include <fstream>
+#include <iterator>
+
+using namespace std;
+
+string Contents(const Path &path)
+{
+  ifstream stream;
+  FS::open(stream, path);
+  return {istreambuf_iterator<char>(stream), istreambuf_iterator<char>()};
+}
@@ -0,0 +1,11 @@
+#ifndef REAPACK_TEST_HELPER_FS_HPP
+#define REAPACK_TEST_HELPER_FS_HPP
+
+#include <string>
+
+class Path;
+
+// the whole contents of a file, empty if it cannot be read
+std::string Contents(const Path &);
+
+#endif
@@ -0,0 +1,242 @@
+#include "http.hpp"
+
+#include <algorithm>
+#include <sstream>
+
+#ifdef _WIN32
+#  include <winsock2.h>
+#  pragma comment(lib, "ws2_32.lib")
+   typedef int socklen_t;
+#else
+#  include <arpa/inet.h>
+#  include <netinet/in.h>
+#  include <sys/select.h>
+#  include <sys/socket.h>
+#  include <unistd.h>
+#  define closesocket close
+#endif
+
+using namespace std;
+
+static void SendAll(const int sock, const char *data, size_t size)
+{
+  while(size > 0) {
+    const int sent = send(sock, data, (int)size, 0);
+    if(sent <= 0)
+      return;
+
+    data += sent;
+    size -= sent;
+  }
+}
+
+static bool WaitReadable(const int sock, const atomic_bool &exit)
+{
+  while(!exit) {
+    fd_set fds;
+    FD_ZERO(&fds);
+    FD_SET(sock, &fds);
+
+    timeval timeout{0, 20000};
+    if(select(sock + 1, &fds, nullptr, nullptr, &timeout) > 0)
+      return true;
+  }
+
+  return false;
+}
+
+static string HeaderValue(const string &request, const string &name)
+{
+  const size_t start = request.find("\r\n" + name + ": ");
+  if(start == string::npos)
+    return {};
+
+  const size_t value = start + name.size() + 4;
+  return request.substr(value, request.find("\r\n", value) - value);
+}
+
+HttpServer::HttpServer()
+  : m_cutAfter(0), m_keepAlive(false), m_stalled(false),
+    m_unknownLength(false), m_connections(0),
+    m_port(0), m_exit(false)
+{
+#ifdef _WIN32
+  WSADATA wsa;
+  WSAStartup(MAKEWORD(2, 2), &wsa);
+#endif
+
+  m_socket = (int)socket(AF_INET, SOCK_STREAM, 0);
+
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = 0;
+
+  socklen_t addrSize = sizeof(addr);
+  bind(m_socket, (sockaddr *)&addr, addrSize);
+  getsockname(m_socket, (sockaddr *)&addr, &addrSize);
+  ::listen(m_socket, 8);
+
+  m_port = ntohs(addr.sin_port);
+  m_thread = thread(&HttpServer::listen, this);
+}
+
+HttpServer::~HttpServer()
+{
+  m_exit = true;
+  m_thread.join();
+  closesocket(m_socket);
+
+#ifdef _WIN32
+  WSACleanup();
+#endif
+}
+
+string HttpServer::url() const
+{
+  return "http://127.0.0.1:" + to_string(m_port) + "/file";
+}
+
+void HttpServer::setResource(const string &body, const string &etag)
+{
+  lock_guard<mutex> guard(m_mutex);
+  m_body = body;
+  m_etag = etag;
+}
+
+void HttpServer::setCutAfter(const size_t bytes)
+{
+  lock_guard<mutex> guard(m_mutex);
+  m_cutAfter = bytes;
+}
+
+void HttpServer::setKeepAlive(const bool keepAlive)
+{
+  lock_guard<mutex> guard(m_mutex);
+  m_keepAlive = keepAlive;
+}
+
+void HttpServer::setStalled(const bool stalled)
+{
+  lock_guard<mutex> guard(m_mutex);
+  m_stalled = stalled;
+}
+
+void HttpServer::setUnknownLength(const bool unknownLength)
+{
+  lock_guard<mutex> guard(m_mutex);
+  m_unknownLength = unknownLength;
+}
+
+int HttpServer::connections() const
+{
+  lock_guard<mutex> guard(m_mutex);
+  return m_connections;
+}
+
+vector<string> HttpServer::requests() const
+{
+  lock_guard<mutex> guard(m_mutex);
+  return m_requests;
+}
+
+vector<int> HttpServer::statuses() const
+{
+  lock_guard<mutex> guard(m_mutex);
+  return m_statuses;
+}
+
+void HttpServer::listen()
+{
+  while(!m_exit) {
+    if(!WaitReadable(m_socket, m_exit))
+      continue;
+
+    const int client = (int)accept(m_socket, nullptr, nullptr);
+    if(client < 0)
+      continue;
+
+    {
+      lock_guard<mutex> guard(m_mutex);
+      m_connections++;
+    }
+
+    while(respond(client) && WaitReadable(client, m_exit))
+      continue;
+    closesocket(client);
+  }
+}
+
+bool HttpServer::respond(const int client)
+{
+  string request;
+  char buffer[4096];
+
+  while(request.find("\r\n\r\n") == string::npos) {
+    const int size = recv(client, buffer, sizeof(buffer), 0);
+    if(size <= 0)
+      return false;
+
+    request.append(buffer, size);
+  }
+
+  unique_lock<mutex> lock(m_mutex);
+  m_requests.push_back(request);
+
+  if(m_stalled) {
+    lock.unlock();
+    WaitReadable(client, m_exit); // the client closed the connection
+    return false;
+  }
+
+  size_t offset = 0, end = m_body.size();
+  const string &range = HeaderValue(request, "Range");
+  const string &ifRange = HeaderValue(request, "If-Range");
+
+  const bool partial = range.compare(0, 6, "bytes=") == 0 &&
+    (ifRange.empty() || ifRange == m_etag);
+
+  if(partial) {
+    const size_t dash = range.find('-');
+    offset = stoul(range.substr(6, dash - 6));
+
+    if(dash + 1 < range.size())
+      end = min(end, stoul(range.substr(dash + 1)) + 1);
+  }
+
+  const int status = partial ? 206 : 200;
+  m_statuses.push_back(status);
+
+  ostringstream head;
+  head << "HTTP/1.1 " << status << (status == 206 ? " Partial Content" : " OK")
+    << "\r\nAccept-Ranges: bytes\r\nETag: " << m_etag
+    << "\r\nContent-Length: " << end - offset << "\r\n";
+
+  if(!m_keepAlive)
+    head << "Connection: close\r\n";
+
+  if(status == 206) {
+    head << "Content-Range: bytes " << offset << '-'
+      << end - 1 << '/';
+
+    if(m_unknownLength)
+      head << '*';
+    else
+      head << m_body.size();
+
+    head << "\r\n";
+  }
+
+  head << "\r\n";
+
+  const string &headers = head.str();
+  SendAll(client, headers.c_str(), headers.size());
+
+  size_t size = end - offset;
+  if(m_cutAfter && m_cutAfter < size)
+    size = m_cutAfter;
+
+  SendAll(client, m_body.c_str() + offset, size);
+
+  return m_keepAlive && size == end - offset;
+}
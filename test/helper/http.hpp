@@ -0,0 +1,55 @@
+#ifndef REAPACK_TEST_HELPER_HTTP_HPP
+#define REAPACK_TEST_HELPER_HTTP_HPP
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Minimal HTTP/1.1 server on the loopback interface serving a single
+// resource with byte range support, one connection at a time.
+class HttpServer {
+public:
+  HttpServer();
+  ~HttpServer();
+
+  std::string url() const;
+
+  void setResource(const std::string &body, const std::string &etag);
+  // close the connection after sending that many bytes of the body
+  void setCutAfter(size_t bytes);
+  // serve the following requests of a client on the same connection
+  void setKeepAlive(bool);
+  // never respond, until the client gives up
+  void setStalled(bool);
+  // send "*" as the total size of the partial responses
+  void setUnknownLength(bool);
+
+  int connections() const;
+
+  std::vector<std::string> requests() const;
+  std::vector<int> statuses() const;
+
+private:
+  void listen();
+  bool respond(int client);
+
+  mutable std::mutex m_mutex;
+  std::string m_body;
+  std::string m_etag;
+  size_t m_cutAfter;
+  bool m_keepAlive;
+  bool m_stalled;
+  bool m_unknownLength;
+  int m_connections;
+  std::vector<std::string> m_requests;
+  std::vector<int> m_statuses;
+
+  int m_socket;
+  int m_port;
+  std::atomic_bool m_exit;
+  std::thread m_thread;
+};
+
+#endif
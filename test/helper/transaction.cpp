@@ -0,0 +1,28 @@
+#include "transaction.hpp"
+
+#include "api.hpp"
+
+#include <download.hpp>
+#include <filesystem.hpp>
+
+const Path UseTransactionEnv::DATA_DIR("Data");
+
+UseTransactionEnv::UseTransactionEnv()
+  : m_root("test")
+{
+  UseStubApi();
+  DownloadContext::GlobalInit();
+  FS::mkdir(Path::DATA);
+
+  config.install.maxCacheSize = 0;
+}
+
+UseTransactionEnv::~UseTransactionEnv()
+{
+  FS::remove(DATA_DIR);
+  FS::remove(Path::REGISTRY);
+  FS::remove(Path::DATA + "transaction.journal.lock");
+  FS::remove(Path::DATA);
+
+  DownloadContext::GlobalCleanup();
+}
@@ -0,0 +1,26 @@
+#ifndef REAPACK_TEST_HELPER_TRANSACTION_HPP
+#define REAPACK_TEST_HELPER_TRANSACTION_HPP
+
+#include "http.hpp"
+
+#include <config.hpp>
+#include <path.hpp>
+
+// Sets up what a transaction needs under the test root path and removes
+// what it left behind. The packages are downloaded from the local server.
+class UseTransactionEnv {
+public:
+  static const Path DATA_DIR; // where data packages are installed
+
+  UseTransactionEnv();
+  UseTransactionEnv(const UseTransactionEnv &) = delete;
+  ~UseTransactionEnv();
+
+  HttpServer server;
+  Config config; // without the download cache
+
+private:
+  UseRootPath m_root;
+};
+
+#endif
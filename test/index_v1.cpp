@@ -305,3 +305,14 @@ TEST_CASE("read multiple sections", M) {
   REQUIRE(ri->category(0)->package(0)->version(0)->source(0)->sections()
     == (Source::MainSection | Source::MIDIEditorSection));
 }
+
+TEST_CASE("read source size", M) {
+  UseRootPath root(RIPATH);
+
+  IndexPtr ri = Index::load("src_size");
+
+  CHECK(ri->packages().size() == 1);
+  const Version *ver = ri->category(0)->package(0)->version(0);
+  REQUIRE(ver->source(0)->size() == 4194304);
+  REQUIRE(ver->source(1)->size() == 0);
+}
@@ -0,0 +1,118 @@
+#include <catch.hpp>
+
+#include <filesystem.hpp>
+#include <hash.hpp>
+#include <journal.hpp>
+
+using namespace std;
+
+static const char *M = "[journal]";
+
+static const Path JOURNAL("journal.txt");
+static const Path LOCK("journal.txt.lock");
+
+static string HashOf(const string &data)
+{
+  Hash hash;
+  hash.addData(data);
+  return hash.digest();
+}
+
+TEST_CASE("resume interrupted transaction", M) {
+  UseRootPath root("test");
+
+  const TempPath paths(Path("journal_file.bin"));
+  REQUIRE(FS::write(paths.temp(), "hello world"));
+
+  {
+    Journal journal(JOURNAL);
+    REQUIRE(journal.interrupted().empty());
+    REQUIRE_FALSE(journal.fetch("http://example.com/file", paths));
+
+    journal.addPlan({true, "remote", "category", "package", "1.0", true});
+    journal.addPlan({false, "remote", "category", "old", {}, false});
+    journal.addDownload("http://example.com/file", paths, HashOf("hello world"));
+  }
+
+  Journal journal(JOURNAL);
+
+  const vector<Journal::Plan> &plans = journal.interrupted();
+  REQUIRE(plans.size() == 2);
+  REQUIRE(plans[0].install);
+  REQUIRE(plans[0].package == "package");
+  REQUIRE(plans[0].version == "1.0");
+  REQUIRE(plans[0].pin);
+  REQUIRE_FALSE(plans[1].install);
+  REQUIRE(plans[1].package == "old");
+
+  SECTION("completed download") {
+    REQUIRE(journal.fetch("http://example.com/file", paths));
+    REQUIRE_FALSE(journal.fetch("http://example.com/other", paths));
+  }
+
+  SECTION("modified download") {
+    REQUIRE(FS::write(paths.temp(), "modified"));
+    REQUIRE_FALSE(journal.fetch("http://example.com/file", paths));
+  }
+
+  SECTION("already moved into place") {
+    REQUIRE(FS::rename(paths));
+    REQUIRE(journal.fetch("http://example.com/file", paths));
+    REQUIRE(FS::exists(paths.temp()));
+    REQUIRE(FS::rename(paths));
+  }
+
+  journal.finish();
+  REQUIRE_FALSE(FS::exists(JOURNAL));
+
+  FS::remove(paths.temp());
+  FS::remove(paths.target());
+  FS::remove(LOCK);
+}
+
+TEST_CASE("ignore truncated journal record", M) {
+  UseRootPath root("test");
+
+  REQUIRE(FS::write(JOURNAL,
+    "install\tremote\tcategory\tpackage\t1.0\t0\n"
+    "install\tremote\tcategory\tpackage\t2.0\t0\n"
+    "install\tremote\tcategory\ttrunc"));
+
+  {
+    Journal journal(JOURNAL);
+    REQUIRE(journal.interrupted().size() == 1);
+    REQUIRE(journal.interrupted()[0].version == "2.0");
+
+    journal.addPlan({true, "remote", "category", "other", "1.0", false});
+  }
+
+  Journal journal(JOURNAL);
+  REQUIRE(journal.interrupted().size() == 2);
+  REQUIRE(journal.interrupted()[1].package == "other");
+
+  journal.finish();
+  FS::remove(LOCK);
+}
+
+TEST_CASE("journal owned by another transaction", M) {
+  UseRootPath root("test");
+
+  {
+    Journal owner(JOURNAL);
+    owner.addPlan({false, "remote", "category", "package", {}, false});
+
+    Journal other(JOURNAL);
+    REQUIRE(other.interrupted().empty());
+
+    other.addPlan({true, "remote", "category", "other", "1.0", false});
+    other.finish();
+    REQUIRE(FS::exists(JOURNAL));
+  }
+
+  Journal journal(JOURNAL);
+  REQUIRE(journal.interrupted().size() == 1);
+  REQUIRE(journal.interrupted()[0].package == "package");
+
+  journal.finish();
+  FS::remove(LOCK);
+}
@@ -0,0 +1,274 @@
+#include <catch.hpp>
+
+#include "helper/api.hpp"
+
+#include <download.hpp>
+#include <filesystem.hpp>
+#include <loopback.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <random>
+#include <thread>
+
+using namespace std;
+
+static const char *M = "[loopback]";
+
+static LoopbackTransport::Resolver Serve(const map<string, string> &files)
+{
+  return [=](const string &url, string *contents) {
+    const auto it = files.find(url);
+    if(it == files.end())
+      return false;
+
+    *contents = it->second;
+    return true;
+  };
+}
+
+static void UseLoopback(const LoopbackTransport::Options &opts,
+  const LoopbackTransport::Resolver &resolver)
+{
+  Transport::setFactory([=] { return new LoopbackTransport(opts, resolver); });
+}
+
+static ThreadTask::State Run(Download *dl)
+{
+  bool done = false;
+  dl->onFinish([&] { done = true; });
+  dl->setCleanupHandler([] {});
+
+  ThreadPool pool;
+  pool.push(dl);
+
+  RunTimers([&] { return done; });
+
+  return dl->state();
+}
+
+static string Body(const size_t size)
+{
+  string body(size, '\0');
+  for(size_t i = 0; i < body.size(); i++)
+    body[i] = 'a' + i % 26;
+  return body;
+}
+
+TEST_CASE("loopback transfer", M) {
+  UseStubApi();
+  const NetworkOpts opts{"", true, 4, 4};
+  const string &body = Body(100000);
+  UseLoopback({}, Serve({{"loop://host/file", body}}));
+
+  SECTION("found") {
+    MemoryDownload dl("loop://host/file", opts);
+    REQUIRE(Run(&dl) == ThreadTask::Success);
+    REQUIRE(dl.contents() == body);
+    REQUIRE(dl.bytesReceived() == (int64_t)body.size());
+  }
+
+  SECTION("not found") {
+    MemoryDownload dl("loop://host/missing", opts);
+    REQUIRE(Run(&dl) == ThreadTask::Failure);
+    REQUIRE(dl.error().message == "The requested URL returned error: 404");
+  }
+
+  Transport::setFactory(nullptr);
+}
+
+TEST_CASE("loopback failures", M) {
+  UseStubApi();
+  const NetworkOpts opts{"", true, 4, 4};
+  UseLoopback({0, 0, 1, 42}, Serve({{"loop://host/file", Body(100000)}}));
+
+  MemoryDownload dl("loop://host/file", opts);
+  REQUIRE(Run(&dl) == ThreadTask::Failure);
+  REQUIRE(dl.error().message == "Simulated network failure");
+
+  Transport::setFactory(nullptr);
+}
+
+TEST_CASE("loopback segmented download", M) {
+  UseStubApi();
+  UseRootPath root("test");
+
+  const NetworkOpts opts{"", true, 4, 4};
+  const Path target("download.bin");
+  const string &body = Body(10 << 20);
+  UseLoopback({0.01, 0, 0, 0}, Serve({{"loop://host/file", body}}));
+
+  {
+    FileDownload dl(target, "loop://host/file", opts, Download::SegmentedFlag);
+    REQUIRE(Run(&dl) == ThreadTask::Success);
+    REQUIRE(dl.save());
+    REQUIRE(dl.bytesReceived() == (int64_t)body.size());
+  }
+
+  ifstream stream;
+  REQUIRE(FS::open(stream, target));
+  REQUIRE(string(istreambuf_iterator<char>(stream), istreambuf_iterator<char>()) == body);
+  stream.close();
+
+  FS::remove(target);
+  Transport::setFactory(nullptr);
+}
+
+TEST_CASE("order queued downloads by expected size", M) {
+  UseStubApi();
+
+  const NetworkOpts opts{"", true, 1, 1};
+  const vector<pair<string, size_t>> files{
+    {"busy", 10}, {"small", 1000}, {"large", 64000}, {"medium", 16000},
+  };
+
+  map<string, string> contents;
+  for(const auto &file : files)
+    contents["loop://host/" + file.first] = Body(file.second);
+  UseLoopback({0.2, 0, 0, 0}, Serve(contents));
+
+  DownloadContext::Order order;
+  vector<string> expected;
+
+  SECTION("largest first") {
+    order = DownloadContext::LargestFirst;
+    expected = {"busy", "large", "medium", "small"};
+  }
+
+  SECTION("smallest first") {
+    order = DownloadContext::SmallestFirst;
+    expected = {"busy", "small", "medium", "large"};
+  }
+
+  SECTION("fifo") {
+    order = DownloadContext::FifoOrder;
+    expected = {"busy", "small", "large", "medium"};
+  }
+
+  DownloadContext::setOrder(order);
+
+  vector<string> finished;
+
+  {
+    ThreadPool pool;
+    TaskGroup group(&pool);
+
+    for(const auto &file : files) {
+      const string &name = file.first;
+      MemoryDownload *dl = new MemoryDownload("loop://host/" + name, opts);
+      dl->setExpectedSize(file.second);
+      dl->onFinish([&, name] { finished.push_back(name); });
+      group.push(dl);
+
+      // the others are queued while the first one waits for its response
+      if(name == "busy") {
+        REQUIRE(RunTimers([&] { return dl->state() == ThreadTask::Running; }));
+        this_thread::sleep_for(chrono::milliseconds(20));
+      }
+    }
+
+    REQUIRE(RunTimers([&] { return group.idle(); }));
+  }
+
+  REQUIRE(finished == expected);
+
+  DownloadContext::setOrder(DownloadContext::LargestFirst);
+  Transport::setFactory(nullptr);
+}
+
+// run with: test '[benchmark]'
+TEST_CASE("download order makespan", "[.benchmark]") {
+  UseStubApi();
+
+  const NetworkOpts opts{"", true, 4, 4};
+  const LoopbackTransport::Options network{0.02, 1 << 20, 0, 0};
+
+  // mostly small scripts with a few large binaries, in a random order
+  mt19937 random(42);
+  uniform_int_distribution<size_t> scriptSize(4 << 10, 64 << 10);
+
+  vector<pair<string, size_t>> files;
+  for(int i = 0; i < 96; i++)
+    files.push_back({"loop://host/script" + to_string(i), scriptSize(random)});
+  for(int i = 0; i < 4; i++)
+    files.push_back({"loop://host/binary" + to_string(i), 4 << 20});
+  shuffle(files.begin(), files.end(), random);
+
+  map<string, string> contents;
+  for(const auto &file : files)
+    contents[file.first] = Body(file.second);
+  UseLoopback(network, Serve(contents));
+
+  const pair<DownloadContext::Order, const char *> orders[] {
+    {DownloadContext::FifoOrder, "fifo"},
+    {DownloadContext::SmallestFirst, "smallest first"},
+    {DownloadContext::LargestFirst, "largest first"},
+  };
+
+  for(const auto &order : orders) {
+    DownloadContext::setOrder(order.first);
+
+    const auto start = chrono::steady_clock::now();
+
+    {
+      ThreadPool pool;
+      TaskGroup group(&pool);
+
+      for(const auto &file : files) {
+        MemoryDownload *dl = new MemoryDownload(file.first, opts);
+        dl->setExpectedSize(file.second);
+        group.push(dl);
+      }
+
+      REQUIRE(RunTimers([&] { return group.idle(); }, 600000));
+    }
+
+    const chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    cout << order.second << ": " << files.size() << " files in "
+      << elapsed.count() << 's' << endl;
+  }
+
+  DownloadContext::setOrder(DownloadContext::LargestFirst);
+  Transport::setFactory(nullptr);
+}
+
+// run with: test '[benchmark]'
+TEST_CASE("loopback download throughput", "[.benchmark]") {
+  UseStubApi();
+
+  const int files = 200;
+  const size_t size = 256 << 10;
+  const NetworkOpts opts{"", true, 4, 4};
+  const LoopbackTransport::Options network{0.05, 2 << 20, 0, 0};
+
+  map<string, string> contents;
+  for(int i = 0; i < files; i++)
+    contents["loop://host/" + to_string(i)] = Body(size);
+  UseLoopback(network, Serve(contents));
+
+  const auto start = chrono::steady_clock::now();
+
+  {
+    ThreadPool pool;
+    TaskGroup group(&pool);
+    bool done = false;
+    group.onDone([&] { done = true; });
+
+    for(const auto &file : contents)
+      group.push(new MemoryDownload(file.first, opts));
+
+    REQUIRE(RunTimers([&] { return done; }, 600000));
+
+    const TaskGroup::Metrics &metrics = group.metrics();
+    REQUIRE(metrics.bytesReceived == (int64_t)(files * size));
+
+    const chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    cout << files << " files of " << (size >> 10) << " KB in "
+      << elapsed.count() << "s (" << metrics.throughput / (1 << 20)
+      << " MB/s while busy)" << endl;
+  }
+
+  Transport::setFactory(nullptr);
+}
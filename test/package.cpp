@@ -276,3 +276,36 @@ TEST_CASE("package display name", M) {
   REQUIRE(pack.displayName(false) == "test.lua");
   REQUIRE(pack.displayName(true) == "hello world");
 }
+
+TEST_CASE("package digest", M) {
+  Index ri("Remote Name");
+  Category cat("Category Name", &ri);
+  Package pack(Package::ScriptType, "test.lua", &cat);
+
+  Version *ver = new Version("1.0", &pack);
+  ver->addSource(new Source({}, "https://example.com/1.0", ver));
+  pack.addVersion(ver);
+
+  const string &digest = pack.digest();
+  REQUIRE(digest.size() == 64);
+  REQUIRE(pack.digest() == digest); // stable
+
+  SECTION("metadata") {
+    pack.setDescription("Hello World");
+    ver->setAuthor("John Doe");
+    REQUIRE(pack.digest() == digest);
+  }
+
+  SECTION("new version") {
+    Version *ver2 = new Version("2.0", &pack);
+    ver2->addSource(new Source({}, "https://example.com/2.0", ver2));
+    pack.addVersion(ver2);
+
+    REQUIRE(pack.digest() != digest);
+  }
+
+  SECTION("new source") {
+    ver->addSource(new Source("extra.lua", "https://example.com/extra", ver));
+    REQUIRE(pack.digest() != digest);
+  }
+}
@@ -0,0 +1,146 @@
+#include <catch.hpp>
+
+#include "helper/api.hpp"
+#include "helper/http.hpp"
+
+#include <download.hpp>
+#include <ratelimit.hpp>
+#include <thread.hpp>
+
+#include <reaper_plugin_functions.h>
+
+using namespace std;
+
+static const char *M = "[ratelimit]";
+
+TEST_CASE("token bucket delay", M) {
+  RateLimiter *limiter = RateLimiter::get();
+  REQUIRE_FALSE(limiter->limited());
+  REQUIRE(limiter->delay() == 0);
+
+  limiter->setRates(1000, 0);
+  REQUIRE(limiter->limited());
+  REQUIRE(limiter->delay() == 0);
+
+  // the bucket starts full with at least 16 KiB
+  limiter->consume(16384 + 500);
+  const int delay = limiter->delay();
+  REQUIRE(delay > 400);
+  REQUIRE(delay <= 500);
+
+  limiter->setRates(0, 0);
+  REQUIRE(limiter->delay() == 0);
+}
+
+TEST_CASE("lower rate while playing or recording", M) {
+  UseStubApi();
+
+  RateLimiter *limiter = RateLimiter::get();
+  limiter->setRates(100000, 2000);
+  REQUIRE(limiter->rate() == 100000);
+
+  SetPlayState(1);
+  limiter->update();
+  REQUIRE(limiter->rate() == 2000);
+
+  SetPlayState(2); // paused
+  limiter->update();
+  REQUIRE(limiter->rate() == 100000);
+
+  SetPlayState(5); // recording
+  limiter->update();
+  REQUIRE(limiter->rate() == 2000);
+
+  limiter->setRates(0, 3000);
+  REQUIRE(limiter->rate() == 3000);
+
+  limiter->setRates(1000, 3000);
+  REQUIRE(limiter->rate() == 1000);
+
+  SetPlayState(0);
+  limiter->update();
+  REQUIRE(limiter->rate() == 1000);
+
+  limiter->setRates(0, 0);
+  REQUIRE_FALSE(limiter->limited());
+}
+
+TEST_CASE("transport state not available", M) {
+  RateLimiter *limiter = RateLimiter::get();
+  limiter->setRates(100000, 2000);
+
+  const auto playState = GetPlayState;
+  GetPlayState = nullptr;
+  limiter->update();
+  GetPlayState = playState;
+
+  REQUIRE(limiter->rate() == 100000);
+  limiter->setRates(0, 0);
+}
+
+TEST_CASE("transport state is polled every few timer ticks", M) {
+  UseStubApi();
+  TickTimer(); // from previous tests
+
+  RateLimiter *limiter = RateLimiter::get();
+  limiter->setRates(100000, 2000);
+  SetPlayState(1);
+
+  ThreadNotifier::get()->start();
+
+  TickTimer(7);
+  REQUIRE(limiter->rate() == 100000);
+
+  TickTimer();
+  REQUIRE(limiter->rate() == 2000);
+
+  ThreadNotifier::get()->stop();
+  TickTimer();
+  REQUIRE_FALSE(HasTimer());
+
+  SetPlayState(0);
+  limiter->update();
+  limiter->setRates(0, 0);
+}
+
+TEST_CASE("rate limit is shared by concurrent downloads", M) {
+  UseStubApi();
+  DownloadContext::GlobalInit();
+
+  const NetworkOpts opts{"", true, 4, 4};
+  const size_t size = 384 << 10;
+
+  HttpServer server;
+  server.setResource(string(size, 'a'), "\"first\"");
+
+  RateLimiter::get()->setRates(512 << 10, 0);
+
+  const auto start = chrono::steady_clock::now();
+  int done = 0;
+
+  {
+    ThreadPool pool;
+
+    for(int i = 0; i < 2; i++) {
+      MemoryDownload *dl = new MemoryDownload(server.url(), opts);
+      dl->onFinish([&, dl] {
+        REQUIRE(dl->state() == ThreadTask::Success);
+        REQUIRE(dl->contents().size() == size);
+        done++;
+      });
+      dl->setCleanupHandler([=] { delete dl; });
+      pool.push(dl);
+    }
+
+    REQUIRE(RunTimers([&] { return done == 2; }));
+  }
+
+  const chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+  RateLimiter::get()->setRates(0, 0);
+  DownloadContext::GlobalCleanup();
+
+  // 768 KiB minus the initial burst of 128 KiB at 512 KiB/s
+  REQUIRE(elapsed.count() >= 1.0);
+  REQUIRE(elapsed.count() < 5.0);
+}
@@ -205,3 +205,88 @@ TEST_CASE("pin registry entry", M) {
   reg.setPinned(entry, false);
   REQUIRE_FALSE(reg.getEntry(&pkg).pinned);
 }
+
+TEST_CASE("file fingerprints", M) {
+  MAKE_PACKAGE
+
+  Registry reg;
+  REQUIRE(reg.getRemoteFiles(ri.name()).empty());
+
+  reg.push(&ver);
+
+  vector<Registry::File> files = reg.getRemoteFiles(ri.name());
+  REQUIRE(files.size() == 1);
+  REQUIRE(files[0].path == src->targetPath());
+  REQUIRE(files[0].type == pkg.type());
+  REQUIRE(files[0].fingerprint.size == -1); // unknown
+
+  reg.setFingerprint(src->targetPath(), {42, 1234});
+
+  files = reg.getFiles(reg.getEntry(&pkg));
+  REQUIRE(files[0].fingerprint.size == 42);
+  REQUIRE(files[0].fingerprint.mtime == 1234);
+
+  REQUIRE(reg.getRemoteFiles(ri.name())[0].fingerprint.size == 42);
+  REQUIRE(reg.getRemoteFiles("Other Remote").empty());
+
+  // reinstalling forgets the fingerprint until the file is written again
+  reg.push(&ver);
+  REQUIRE(reg.getRemoteFiles(ri.name())[0].fingerprint.size == -1);
+}
+
+TEST_CASE("synchronization digests", M) {
+  MAKE_PACKAGE
+
+  Registry reg;
+  REQUIRE(reg.getDigests(ri.name()).empty());
+
+  reg.setDigest(&pkg, "abc");
+
+  Registry::Digests digests = reg.getDigests(ri.name());
+  REQUIRE(digests.size() == 1);
+  REQUIRE(digests[{"Category Name", "Hello"}] == "abc");
+  REQUIRE(reg.getDigests("Other Remote").empty());
+
+  SECTION("install") {
+    reg.push(&ver);
+    REQUIRE(reg.getDigests(ri.name()).empty());
+  }
+
+  SECTION("pin") {
+    reg.setPinned({1, ri.name(), cat.name(), pkg.name()}, true);
+    REQUIRE(reg.getDigests(ri.name()).empty());
+  }
+
+  SECTION("uninstall") {
+    const Registry::Entry &entry = reg.push(&ver);
+    reg.setDigest(&pkg, "def");
+    reg.forget(entry);
+    REQUIRE(reg.getDigests(ri.name()).empty());
+  }
+}
+
+TEST_CASE("index synchronization digests", M) {
+  MAKE_PACKAGE
+
+  Registry reg;
+  time_t verified;
+  REQUIRE(reg.getIndexDigest(ri.name(), &verified).empty());
+  REQUIRE(verified == 0);
+
+  reg.setIndexDigest(ri.name(), "abc", 1234);
+  REQUIRE(reg.getIndexDigest(ri.name(), &verified) == "abc");
+  REQUIRE(verified == 1234);
+  REQUIRE(reg.getIndexDigest("Other Remote", &verified).empty());
+
+  SECTION("install") {
+    reg.push(&ver);
+    REQUIRE(reg.getIndexDigest(ri.name(), &verified).empty());
+  }
+
+  SECTION("package removed from the index") {
+    reg.setDigest(&pkg, "def");
+    reg.forgetDigest(ri.name(), cat.name(), pkg.name());
+    REQUIRE(reg.getDigests(ri.name()).empty());
+    REQUIRE(reg.getIndexDigest(ri.name(), &verified).empty());
+  }
+}
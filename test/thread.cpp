@@ -0,0 +1,280 @@
+#include <catch.hpp>
+
+#include "helper/api.hpp"
+
+#include <thread.hpp>
+
+#include <functional>
+#include <iostream>
+#include <thread>
+
+#ifdef __linux__
+#  include <sched.h>
+#  include <sys/resource.h>
+#  include <sys/syscall.h>
+#  include <unistd.h>
+#endif
+
+using namespace std;
+
+static const char *M = "[thread]";
+
+class SerialTask : public ThreadTask {
+public:
+  bool concurrent() const override { return false; }
+
+  void run(DownloadContext *) override
+  {
+    finish(aborted() ? Aborted : Success);
+  }
+};
+
+class SizedTask : public SerialTask {
+public:
+  SizedTask(const int64_t size) : m_size(size) {}
+
+  void run(DownloadContext *ctx) override
+  {
+    setBytes(m_size, m_size);
+    SerialTask::run(ctx);
+  }
+
+private:
+  int64_t m_size;
+};
+
+TEST_CASE("task groups share the thread pool", M) {
+  UseStubApi();
+
+  ThreadPool pool;
+  TaskGroup first(&pool), second(&pool);
+
+  int done = 0;
+  first.onDone([&] { done++; });
+  second.onDone([&] { done++; });
+
+  SerialTask *aborted = new SerialTask;
+  SerialTask *succeeded = new SerialTask;
+
+  ThreadTask::State firstState = ThreadTask::Idle, secondState = ThreadTask::Idle;
+  aborted->onFinish([&] { firstState = aborted->state(); });
+  succeeded->onFinish([&] { secondState = succeeded->state(); });
+
+  first.push(aborted);
+  second.push(succeeded);
+  first.abort();
+
+  REQUIRE_FALSE(first.idle());
+  REQUIRE(RunTimers([&] { return done == 2; }));
+
+  REQUIRE(first.idle());
+  REQUIRE(second.idle());
+  REQUIRE(secondState == ThreadTask::Success);
+  REQUIRE(firstState != ThreadTask::Idle);
+}
+
+TEST_CASE("task group metrics of finished tasks", M) {
+  UseStubApi();
+
+  ThreadPool pool;
+  TaskGroup group(&pool);
+
+  bool done = false;
+  group.onDone([&] { done = true; });
+
+  group.push(new SizedTask(100));
+  group.push(new SizedTask(300));
+  group.push(new SizedTask(0));
+
+  REQUIRE(RunTimers([&] { return done; }));
+
+  // the task without data is not part of the average size
+  const TaskGroup::Metrics &metrics = group.metrics();
+  REQUIRE(metrics.bytesReceived == 400);
+  REQUIRE(metrics.bytesTotal == 400);
+  REQUIRE(metrics.sizedTasks == 2);
+}
+
+TEST_CASE("destroy task group while tasks are running", M) {
+  UseStubApi();
+
+  ThreadPool pool;
+  bool finished = false;
+
+  {
+    TaskGroup group(&pool);
+    SerialTask *task = new SerialTask;
+    task->onFinish([&] { finished = true; });
+    group.push(task);
+  }
+
+  REQUIRE(RunTimers([&] { return finished; }));
+}
+
+class ParallelTask : public ThreadTask {
+public:
+  ParallelTask(const atomic_bool *wait = nullptr) : m_wait(wait) {}
+
+  bool concurrent() const override { return false; }
+  bool parallel() const override { return true; }
+
+  void run(DownloadContext *) override
+  {
+    while(m_wait && *m_wait)
+      this_thread::sleep_for(chrono::milliseconds(1));
+
+    finish(Success);
+  }
+
+private:
+  const atomic_bool *m_wait;
+};
+
+TEST_CASE("idle workers steal queued tasks", M) {
+  UseStubApi();
+
+  ThreadPool pool(2);
+  TaskGroup group(&pool);
+
+  atomic_bool blocked(true);
+  int finished = 0;
+
+  // the first worker is stuck on this one
+  ParallelTask *slow = new ParallelTask(&blocked);
+  slow->onFinish([&] { finished = -1; });
+  group.push(slow);
+
+  for(int i = 0; i < 6; i++) {
+    ParallelTask *task = new ParallelTask;
+    task->onFinish([&] { finished++; });
+    group.push(task);
+  }
+
+  REQUIRE(RunTimers([&] { return finished == 6; }));
+
+  blocked = false;
+  REQUIRE(RunTimers([&] { return group.idle(); }));
+  REQUIRE(finished == -1);
+}
+
+TEST_CASE("notification delivery statistics", M) {
+  UseStubApi();
+
+  ThreadPool pool;
+  SerialTask task;
+  ThreadNotifier::Stats stats{};
+  bool done = false;
+  task.onFinish([&] { stats = ThreadNotifier::get()->stats(); done = true; });
+  task.setCleanupHandler([] {});
+
+  pool.push(&task);
+  REQUIRE(RunTimers([&] { return done; }));
+
+  REQUIRE(stats.ticks >= 1);
+  REQUIRE(stats.depth == 0);
+  REQUIRE(stats.maxDepth >= 1);
+  REQUIRE(stats.delivered >= 1);
+  REQUIRE(stats.maxLatency >= stats.averageLatency);
+  REQUIRE(stats.averageLatency >= 0);
+}
+
+TEST_CASE("main thread timer only runs while tasks are running", M) {
+  UseStubApi();
+  TickTimer(); // from previous tests
+
+  ThreadPool pool;
+  SerialTask *task = new SerialTask;
+  REQUIRE_FALSE(HasTimer());
+
+  bool done = false;
+  task->onFinish([&] { done = true; });
+  task->setCleanupHandler([=] { delete task; });
+
+  pool.push(task);
+  REQUIRE(HasTimer());
+
+  REQUIRE(RunTimers([&] { return done; }));
+  REQUIRE_FALSE(HasTimer());
+}
+
+TEST_CASE("parse reserved cpu list", M) {
+  REQUIRE(ThreadPool::CpuMask("") == 0);
+  REQUIRE(ThreadPool::CpuMask("0") == 0b1);
+  REQUIRE(ThreadPool::CpuMask("0,2-3") == 0b1101);
+  REQUIRE(ThreadPool::CpuMask(" 1 , 3-2,5") == 0b100010);
+  REQUIRE(ThreadPool::CpuMask("hello,4") == 0b10000);
+  REQUIRE(ThreadPool::CpuMask("62-70") == 0xc000000000000000);
+}
+
+#ifdef __linux__
+class ProbeTask : public ThreadTask {
+public:
+  ProbeTask(const function<void ()> &probe) : m_probe(probe) {}
+
+  bool concurrent() const override { return false; }
+  bool parallel() const override { return true; }
+
+  void run(DownloadContext *) override
+  {
+    m_probe();
+    finish(Success);
+  }
+
+private:
+  function<void ()> m_probe;
+};
+
+TEST_CASE("run background workers at low priority", M) {
+  UseStubApi();
+
+  cpu_set_t process;
+  REQUIRE(sched_getaffinity(getpid(), sizeof(process), &process) == 0);
+
+  int firstCpu = 0;
+  while(!CPU_ISSET(firstCpu, &process))
+    firstCpu++;
+
+  ThreadPool pool(1);
+  pool.setScheduling(true, to_string(firstCpu));
+
+  int nice = 0;
+  cpu_set_t worker;
+  ProbeTask task([&] {
+    nice = getpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)));
+    sched_getaffinity(0, sizeof(worker), &worker);
+  });
+  bool done = false;
+  task.onFinish([&] { done = true; });
+  task.setCleanupHandler([] {});
+
+  pool.push(&task);
+  REQUIRE(RunTimers([&] { return done; }));
+
+  REQUIRE(nice == 19);
+
+  if(CPU_COUNT(&process) > 1) {
+    REQUIRE_FALSE(CPU_ISSET(firstCpu, &worker));
+    REQUIRE(CPU_COUNT(&worker) == CPU_COUNT(&process) - 1);
+  }
+}
+#endif
+
+// run with: test '[benchmark]'
+TEST_CASE("idle main thread tick", "[.benchmark]") {
+  UseStubApi();
+
+  ThreadPool pool;
+  TaskGroup group(&pool);
+  atomic_bool blocked(true);
+  group.push(new ParallelTask(&blocked)); // keeps the timer registered
+
+  const int ticks = 10000000;
+  const auto start = chrono::steady_clock::now();
+  TickTimer(ticks);
+  const chrono::duration<double, nano> elapsed = chrono::steady_clock::now() - start;
+
+  cout << elapsed.count() / ticks << " ns per idle tick" << endl;
+
+  blocked = false;
+  REQUIRE(RunTimers([&] { return group.idle(); }));
+}
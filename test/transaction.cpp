@@ -0,0 +1,183 @@
+#include <catch.hpp>
+
+#include "helper/api.hpp"
+#include "helper/fs.hpp"
+#include "helper/transaction.hpp"
+
+#include <download.hpp>
+#include <filesystem.hpp>
+#include <index.hpp>
+#include <registry.hpp>
+#include <transaction.hpp>
+
+using namespace std;
+
+static const char *M = "[transaction]";
+
+static const Path &DATA_DIR = UseTransactionEnv::DATA_DIR;
+
+// one data package per file, all downloaded from the same URL
+static IndexPtr MakeIndex(const string &url, const vector<string> &files)
+{
+  auto ri = make_shared<Index>("Remote Name");
+  Category *cat = new Category("Category Name", ri.get());
+
+  for(const string &file : files) {
+    Package *pkg = new Package(Package::DataType, file, cat);
+    Version *ver = new Version("1.0", pkg);
+    ver->addSource(new Source(file, url, ver));
+    pkg->addVersion(ver);
+    cat->addPackage(pkg);
+  }
+
+  ri->addCategory(cat);
+  return ri;
+}
+
+static void Run(Transaction *tx)
+{
+  bool done = false;
+  tx->setCleanupHandler([&] { done = true; });
+  tx->runTasks();
+
+  REQUIRE(RunTimers([&] { return done; }));
+  REQUIRE_FALSE(tx->receipt()->hasErrors());
+}
+
+TEST_CASE("download each URL once", M) {
+  UseTransactionEnv env;
+  env.server.setResource("hello world", "\"first\"");
+
+  {
+    const IndexPtr &ri = MakeIndex(env.server.url(), {"a.txt", "b.txt", "c.txt"});
+
+    ThreadPool pool;
+    Transaction tx(&env.config, &pool);
+
+    for(const Package *pkg : ri->packages())
+      tx.install(pkg->lastVersion());
+
+    Run(&tx);
+  }
+
+  REQUIRE(env.server.requests().size() == 1);
+
+  for(const char *file : {"a.txt", "b.txt", "c.txt"}) {
+    REQUIRE(Contents(DATA_DIR + file) == "hello world");
+    FS::remove(DATA_DIR + file);
+  }
+
+}
+
+TEST_CASE("install a package twice in a transaction", M) {
+  UseTransactionEnv env;
+  env.server.setResource("hello world", "\"first\"");
+
+  {
+    const IndexPtr &ri = MakeIndex(env.server.url(), {"a.txt"});
+    const Version *ver = ri->packages()[0]->lastVersion();
+
+    ThreadPool pool;
+    Transaction tx(&env.config, &pool);
+    tx.install(ver);
+    tx.install(ver);
+
+    Run(&tx);
+  }
+
+  REQUIRE(env.server.requests().size() == 1);
+
+  const TempPath paths(DATA_DIR + "a.txt");
+  REQUIRE(Contents(paths.target()) == "hello world");
+  REQUIRE_FALSE(FS::exists(paths.temp()));
+
+  FS::remove(paths.target());
+}
+
+TEST_CASE("install two versions of a package in a transaction", M) {
+  UseTransactionEnv env;
+  env.server.setResource("hello world", "\"first\"");
+
+  // each version releases the file of the other one
+  auto ri = make_shared<Index>("Remote Name");
+  Category *cat = new Category("Category Name", ri.get());
+  Package *pkg = new Package(Package::DataType, "Package Name", cat);
+
+  for(const char *name : {"1.0", "2.0"}) {
+    Version *ver = new Version(name, pkg);
+    ver->addSource(new Source(string(name) + ".txt", env.server.url(), ver));
+    pkg->addVersion(ver);
+  }
+
+  cat->addPackage(pkg);
+  ri->addCategory(cat);
+
+  const Version *v1 = pkg->findVersion(VersionName("1.0"));
+  const Version *v2 = pkg->findVersion(VersionName("2.0"));
+
+  {
+    ThreadPool pool;
+
+    {
+      Transaction tx(&env.config, &pool);
+      tx.install(v1);
+      Run(&tx);
+    }
+
+    Transaction tx(&env.config, &pool);
+    tx.install(v2);
+    tx.install(v1);
+    Run(&tx);
+  }
+
+  // the files of the version committed last are the only ones left
+  const Registry::Entry &entry =
+    Registry(Path::prefixRoot(Path::REGISTRY)).getEntry(pkg);
+  const bool isV1 = entry.version == v1->name();
+
+  REQUIRE(FS::exists(DATA_DIR + "1.0.txt") == isV1);
+  REQUIRE(FS::exists(DATA_DIR + "2.0.txt") == !isV1);
+
+  // both were committed
+  for(const char *file : {"1.0.txt", "2.0.txt"})
+    REQUIRE_FALSE(FS::exists(TempPath(DATA_DIR + file).temp()));
+
+  FS::remove(DATA_DIR + (isV1 ? "1.0.txt" : "2.0.txt"));
+}
+
+TEST_CASE("cancel a transaction with waiting downloads", M) {
+  UseTransactionEnv env;
+  env.server.setResource("hello world", "\"first\"");
+  env.server.setStalled(true);
+
+  vector<ThreadTask::State> states;
+
+  {
+    const IndexPtr &ri = MakeIndex(env.server.url(), {"a.txt"});
+    const Version *ver = ri->packages()[0]->lastVersion();
+
+    ThreadPool pool;
+    Transaction tx(&env.config, &pool);
+    tx.tasks()->onPush([&] (ThreadTask *task) {
+      task->onFinish([&, task] { states.push_back(task->state()); });
+    });
+
+    tx.install(ver);
+    tx.install(ver);
+
+    bool done = false;
+    tx.setCleanupHandler([&] { done = true; });
+    tx.runTasks();
+
+    // the duplicate is waiting for the stalled download
+    REQUIRE(RunTimers([&] { return env.server.requests().size() == 1; }));
+    tx.tasks()->abort();
+
+    REQUIRE(RunTimers([&] { return done; }));
+    REQUIRE(tx.isCancelled());
+  }
+
+  REQUIRE(env.server.requests().size() == 1);
+  REQUIRE(states == vector<ThreadTask::State>(2, ThreadTask::Aborted));
+  REQUIRE_FALSE(FS::exists(DATA_DIR + "a.txt"));
+}